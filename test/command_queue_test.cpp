@@ -0,0 +1,128 @@
+// command_queue_test.cpp
+// Stress test of MpscQueue: producers push single items and all-or-nothing batches
+// while one consumer drains. Checks that nothing is lost, duplicated or reordered per
+// producer, and that every batch comes out whole and contiguous.
+#include "command_queue.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::exit(1); \
+        } \
+    } while (0)
+
+namespace {
+    struct Item {
+        uint32_t producer;
+        uint32_t sequence;
+        uint32_t batch;     // 0 for single pushes
+        uint32_t batchSize;
+        uint32_t batchIndex;
+    };
+
+    const size_t PRODUCERS = 8;
+    const uint32_t ITEMS_PER_PRODUCER = 200000;
+    const size_t MAX_BATCH = 8;
+
+    MpscQueue<Item, 64> queue;
+
+
+    void produce(uint32_t producer) {
+        uint32_t sequence = 0;
+        uint32_t batch = 1;
+        Item items[MAX_BATCH];
+        while (sequence < ITEMS_PER_PRODUCER) {
+            // Every fourth push is a batch of 2 to MAX_BATCH items
+            size_t size = (sequence % 4 == 0) ? 2 + (sequence / 4) % (MAX_BATCH - 1) : 1;
+            if (size > ITEMS_PER_PRODUCER - sequence) {
+                size = ITEMS_PER_PRODUCER - sequence;
+            }
+            for (size_t i = 0; i < size; ++i) {
+                items[i] = {producer, sequence + uint32_t(i), size > 1 ? batch : 0, uint32_t(size), uint32_t(i)};
+            }
+            bool pushed = size > 1 ? queue.tryPushAll(items, size) : queue.tryPush(items[0]);
+            if (!pushed) {
+                std::this_thread::yield();
+                continue;
+            }
+            sequence += size;
+            batch += size > 1;
+        }
+    }
+
+
+    void testEdgeCases() {
+        MpscQueue<int, 4> small;
+        int values[5] = {1, 2, 3, 4, 5};
+        CHECK(small.tryPushAll(values, 0));
+        CHECK(!small.tryPushAll(values, 5)); // Larger than the queue
+        CHECK(small.tryPushAll(values, 3));
+        CHECK(!small.tryPushAll(values, 2)); // Only one slot left, nothing is pushed
+        CHECK(small.tryPush(values[3]));
+        CHECK(!small.tryPush(values[4]));
+
+        int value = 0;
+        for (int expected = 1; expected <= 4; ++expected) {
+            CHECK(small.tryPop(value) && value == expected);
+        }
+        CHECK(!small.tryPop(value));
+
+        // Wrap around
+        for (int round = 0; round < 10; ++round) {
+            CHECK(small.tryPushAll(values, 3));
+            for (int expected = 1; expected <= 3; ++expected) {
+                CHECK(small.tryPop(value) && value == expected);
+            }
+        }
+    }
+}
+
+
+int main() {
+    testEdgeCases();
+
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back(produce, p);
+    }
+
+    std::vector<uint32_t> next(PRODUCERS, 0);
+    uint64_t received = 0;
+    const uint64_t total = uint64_t(PRODUCERS) * ITEMS_PER_PRODUCER;
+    Item item;
+    while (received < total) {
+        if (!queue.tryPop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        CHECK(item.producer < PRODUCERS);
+        CHECK(item.sequence == next[item.producer]);
+        next[item.producer]++;
+        received++;
+
+        // The rest of a batch follows directly, it is published right after its first item
+        for (uint32_t i = 1; i < item.batchSize; ++i) {
+            Item member;
+            while (!queue.tryPop(member)) {
+                std::this_thread::yield();
+            }
+            CHECK(member.producer == item.producer && member.batch == item.batch && member.batchIndex == i);
+            CHECK(member.sequence == next[item.producer]);
+            next[item.producer]++;
+            received++;
+        }
+    }
+
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    CHECK(!queue.tryPop(item));
+    std::printf("command_queue: %zu producers, %llu items, ok\n", PRODUCERS, (unsigned long long)received);
+    return 0;
+}
@@ -0,0 +1,212 @@
+// io_expander_test.cpp
+// PCA9685 and MCP23017 drivers against a mock I2C bus that keeps a register file per
+// chip and counts transactions. Checks the batching (one transaction per register block),
+// the register encoding, retries after a failed write, and that the three-step flush
+// ExpanderManager uses keeps every bus transaction outside the shadow register lock.
+#include "io_expander.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::exit(1); \
+        } \
+    } while (0)
+
+namespace {
+    // Register auto-increment bus: the first byte sets the register pointer, the rest
+    // are written from there on
+    class I2cBus {
+    public:
+        std::atomic<uint32_t> transactions{0};
+        std::atomic<uint32_t> bytes{0};
+        std::atomic<int> failures{0};          // The next this many writes fail
+        std::atomic<bool>* lockHeld = nullptr; // Set while the shadow lock is held, must be false here
+
+        uint8_t registers[128][256] = {};
+        std::vector<size_t> lengths; // Of every transaction, in order
+
+        IoExpander::BusWrite writer() {
+            return [this](uint8_t address, const uint8_t* data, size_t len) { return write(address, data, len); };
+        }
+
+        bool write(uint8_t address, const uint8_t* data, size_t len) {
+            if (lockHeld != nullptr) {
+                CHECK(!lockHeld->load());
+            }
+            transactions++;
+            bytes += len;
+            lengths.push_back(len);
+            if (failures > 0) {
+                failures--;
+                return false;
+            }
+            CHECK(len >= 1);
+            uint8_t reg = data[0];
+            for (size_t i = 1; i < len; ++i) {
+                registers[address][reg++] = data[i];
+            }
+            return true;
+        }
+
+        void reset() {
+            transactions = 0;
+            bytes = 0;
+            lengths.clear();
+        }
+    };
+
+    // Value a PCA9685 channel outputs, from its four registers
+    uint16_t pcaChannel(const I2cBus& bus, uint8_t address, size_t channel) {
+        const uint8_t* reg = &bus.registers[address][0x06 + 4 * channel];
+        if (reg[3] & 0x10) {
+            return 0; // Full off
+        }
+        if (reg[1] & 0x10) {
+            return IoExpander::PWM_MAX; // Full on
+        }
+        return reg[2] | (reg[3] & 0x0F) << 8;
+    }
+
+    void testPca9685() {
+        I2cBus bus;
+        Pca9685 chip(bus.writer(), 0x40, 200);
+        CHECK(chip.begin());
+        CHECK(bus.registers[0x40][0xFE] == 30); // 25 MHz / (4096 * 200 Hz) - 1, rounded
+        bus.reset();
+
+        // Channels 3 to 9 go out in one transaction, register address plus 7 channels
+        chip.write(3, 1000);
+        chip.write(9, IoExpander::PWM_MAX);
+        chip.write(5, 0);  // Already 0, nothing to send
+        chip.write(3, 1000);
+        CHECK(chip.skippedWrites() == 2);
+        CHECK(chip.flush());
+        CHECK(bus.transactions == 1);
+        CHECK(bus.lengths[0] == 1 + 4 * 7);
+        CHECK(pcaChannel(bus, 0x40, 3) == 1000);
+        CHECK(pcaChannel(bus, 0x40, 9) == IoExpander::PWM_MAX);
+        CHECK(pcaChannel(bus, 0x40, 5) == 0);
+
+        // Nothing changed, nothing sent
+        CHECK(chip.flush());
+        CHECK(bus.transactions == 1);
+
+        // A failed write is kept and sent again
+        chip.write(0, 2048);
+        bus.failures = 1;
+        CHECK(!chip.flush());
+        CHECK(pcaChannel(bus, 0x40, 0) == 0);
+        CHECK(chip.flush());
+        CHECK(pcaChannel(bus, 0x40, 0) == 2048);
+        CHECK(chip.transactions() == bus.transactions + 5); // begin() sent 5 before the reset
+
+        std::printf("PCA9685: one transaction per flush, retried after a failure\n");
+    }
+
+    void testMcp23017() {
+        I2cBus bus;
+        Mcp23017 chip(bus.writer(), 0x20);
+        CHECK(chip.begin());
+        bus.reset();
+
+        // Port A only: one byte for the latch, one for the direction
+        chip.write(2, 1);
+        chip.setOutput(2, true);
+        CHECK(chip.flush());
+        CHECK(bus.transactions == 2);
+        CHECK(bus.lengths[0] == 2 && bus.lengths[1] == 2);
+        CHECK(bus.registers[0x20][0x14] == 0x04); // OLATA
+        CHECK(bus.registers[0x20][0x00] == 0xFB); // IODIRA
+
+        // Both ports of the latch in one transaction, directions unchanged
+        chip.write(0, 1);
+        chip.write(15, 1);
+        CHECK(chip.flush());
+        CHECK(bus.transactions == 3);
+        CHECK(bus.lengths[2] == 3);
+        CHECK(bus.registers[0x20][0x14] == 0x05 && bus.registers[0x20][0x15] == 0x80);
+
+        // A failed latch write holds back the direction change, both go out next time
+        chip.write(9, 1);
+        chip.setOutput(9, true);
+        bus.failures = 1;
+        CHECK(!chip.flush());
+        CHECK(bus.transactions == 4);
+        CHECK(bus.registers[0x20][0x01] == 0xFF);
+        CHECK(chip.flush());
+        CHECK(bus.transactions == 6);
+        CHECK(bus.registers[0x20][0x15] == 0x82);
+        CHECK(bus.registers[0x20][0x01] == 0xFD);
+        CHECK(chip.read(9) == 1);
+
+        std::printf("MCP23017: half and full port writes, directions wait for the latches\n");
+    }
+
+    // ExpanderManager's pattern: writes and capture/complete under the lock, transmit
+    // without it, while another thread keeps reading the shadows under the same lock
+    void testTwoPhaseFlush() {
+        I2cBus bus;
+        std::atomic<bool> lockHeld(false);
+        std::mutex shadowMutex;
+        Pca9685 chip(bus.writer(), 0x41, 1000);
+        CHECK(chip.begin());
+        bus.lockHeld = &lockHeld;
+
+        std::atomic<bool> done(false);
+        std::atomic<bool> reading(false);
+        std::thread reader([&] {
+            uint32_t reads = 0;
+            while (!done) {
+                std::lock_guard<std::mutex> lock(shadowMutex);
+                reads += chip.read(reads % Pca9685::CHANNELS) <= IoExpander::PWM_MAX;
+                (void)chip.transactions();
+                reading = true;
+            }
+        });
+        // The ticks only overlap the reader once it is running
+        while (!reading) {
+            std::this_thread::yield();
+        }
+
+        const int TICKS = 20000;
+        IoExpander::Batch batch;
+        for (int tick = 0; tick < TICKS; ++tick) {
+            {
+                std::lock_guard<std::mutex> lock(shadowMutex);
+                lockHeld = true;
+                chip.write(tick % Pca9685::CHANNELS, tick % (IoExpander::PWM_MAX + 1));
+                chip.capture(batch);
+                lockHeld = false;
+            }
+            chip.transmit(batch);
+            {
+                std::lock_guard<std::mutex> lock(shadowMutex);
+                lockHeld = true;
+                chip.complete(batch);
+                lockHeld = false;
+            }
+        }
+        done = true;
+        reader.join();
+
+        for (size_t channel = 0; channel < Pca9685::CHANNELS; ++channel) {
+            CHECK(pcaChannel(bus, 0x41, channel) == chip.read(channel));
+        }
+        std::printf("two-phase flush: %d ticks, %u transactions, none under the lock\n", TICKS, bus.transactions.load());
+    }
+}
+
+int main() {
+    testPca9685();
+    testMcp23017();
+    testTwoPhaseFlush();
+    return 0;
+}
@@ -0,0 +1,128 @@
+// led_pipeline_bench.cpp
+// Per-frame cost of the LED output stage as renderLedFrame runs it: gammaSum over every
+// strip, one budgetScale, then renderStrip into each frame buffer. Also checks that a
+// full white frame over budget is scaled so its average draw stays within the budget,
+// when dithering asks for further frames, and the frame interval for the strips' wire time.
+#include "led_pipeline.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::exit(1); \
+        } \
+    } while (0)
+
+namespace {
+    const LedPipeline::PowerBudget BUDGET = {2000, 20, 1}; // As in input_config.cpp
+
+    struct Strips {
+        std::vector<std::vector<uint8_t>> colors;
+        std::vector<std::vector<uint8_t>> frames;
+        size_t ledCount = 0;
+    };
+
+    Strips makeStrips(size_t strips, size_t ledsPerStrip, uint32_t seed) {
+        std::mt19937 rng(seed);
+        Strips result;
+        for (size_t i = 0; i < strips; ++i) {
+            std::vector<uint8_t> colors(ledsPerStrip * 3);
+            for (uint8_t& channel : colors) {
+                channel = static_cast<uint8_t>(rng());
+            }
+            result.colors.push_back(colors);
+            result.frames.emplace_back(ledsPerStrip * 3);
+            result.ledCount += ledsPerStrip;
+        }
+        return result;
+    }
+
+    LedPipeline::FrameStats renderFrame(Strips& strips, uint8_t frame) {
+        uint64_t gammaTotal = 0;
+        for (const std::vector<uint8_t>& colors : strips.colors) {
+            gammaTotal += LedPipeline::gammaSum(colors.data(), colors.size());
+        }
+        LedPipeline::FrameStats stats = LedPipeline::budgetScale(gammaTotal, strips.ledCount, BUDGET);
+        for (size_t i = 0; i < strips.colors.size(); ++i) {
+            LedPipeline::renderStrip(strips.colors[i].data(), strips.frames[i].data(), strips.colors[i].size(), stats.scaleQ16, frame);
+        }
+        return stats;
+    }
+
+    // White at full brightness asks for 60 mA per LED, far over the budget
+    void checkBudget() {
+        Strips strips = makeStrips(2, 300, 1);
+        for (std::vector<uint8_t>& colors : strips.colors) {
+            std::fill(colors.begin(), colors.end(), 255);
+        }
+        uint64_t channelTotal = 0;
+        const int FRAMES = 256;
+        LedPipeline::FrameStats stats = {};
+        for (int frame = 0; frame < FRAMES; ++frame) {
+            stats = renderFrame(strips, static_cast<uint8_t>(frame));
+            for (const std::vector<uint8_t>& out : strips.frames) {
+                for (uint8_t channel : out) {
+                    channelTotal += channel;
+                }
+            }
+        }
+        double averageMa = strips.ledCount * BUDGET.idleMaPerLed +
+                           static_cast<double>(channelTotal) / FRAMES / 255 * BUDGET.maPerChannel;
+        std::printf("full white, 600 LEDs: requested %u mA, scaled to %.0f mA average (budget %u mA)\n",
+                    stats.requestedMa, averageMa, BUDGET.budgetMa);
+        CHECK(stats.requestedMa > BUDGET.budgetMa);
+        CHECK(averageMa <= BUDGET.budgetMa * 1.01);
+    }
+
+    // Only fractions that some threshold rounds up ask for more frames, and the frame
+    // interval leaves the control task half its time at any strip length
+    void checkFrameScheduling() {
+        std::vector<uint8_t> colors(300 * 3, 0);
+        std::vector<uint8_t> frame(colors.size());
+        CHECK(!LedPipeline::renderStrip(colors.data(), frame.data(), colors.size(), LedPipeline::SCALE_ONE, 0));
+        std::fill(colors.begin(), colors.end(), 255);
+        CHECK(!LedPipeline::renderStrip(colors.data(), frame.data(), colors.size(), LedPipeline::SCALE_ONE, 0));
+        CHECK(LedPipeline::renderStrip(colors.data(), frame.data(), colors.size(), LedPipeline::SCALE_ONE / 3, 0));
+        colors[40] = 100;
+        CHECK(LedPipeline::renderStrip(colors.data(), frame.data(), colors.size(), LedPipeline::SCALE_ONE, 0));
+
+        CHECK(LedPipeline::frameIntervalMs(0, 10, 2) == 10);
+        CHECK(LedPipeline::frameIntervalMs(150, 10, 2) == 10);
+        for (size_t leds : {60, 300, 1000, 2000}) {
+            uint32_t interval = LedPipeline::frameIntervalMs(leds, 10, 2);
+            uint32_t showUs = leds * LedPipeline::WIRE_US_PER_LED + LedPipeline::LATCH_US;
+            CHECK(showUs * 2 <= interval * 1000);
+            std::printf("%zu LEDs: show() %.1f ms, a frame every %u ms (%.0f FPS)\n", leds, showUs / 1000.0, interval, 1000.0 / interval);
+        }
+    }
+
+    void benchmark(size_t strips, size_t ledsPerStrip) {
+        Strips set = makeStrips(strips, ledsPerStrip, 7);
+        const int FRAMES = 20000;
+        uint32_t sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < FRAMES; ++frame) {
+            renderFrame(set, static_cast<uint8_t>(frame));
+            sink += set.frames[0][frame % set.frames[0].size()];
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / FRAMES;
+        std::printf("%zu x %zu LEDs: %.2f us per frame, %.1f ns per LED (%u)\n",
+                    strips, ledsPerStrip, us, us * 1000 / (strips * ledsPerStrip), sink & 1);
+    }
+}
+
+int main() {
+    LedPipeline::init(2.2f);
+    checkBudget();
+    checkFrameScheduling();
+    benchmark(1, 60);
+    benchmark(2, 300);
+    benchmark(4, 500);
+    return 0;
+}
@@ -0,0 +1,118 @@
+// log_bench.cpp
+// Per-call cost of the LOG_* macros against the AddToLog they replaced, on the
+// real log_manager.cpp built against the stubs in stubs/. AddToLog is copied from
+// before the binary log: it formatted a String, appended it to a vector and trimmed
+// the vector to 1024 characters on every call. Also checks the %s truncation marker.
+#include "log_manager.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::exit(1); \
+        } \
+    } while (0)
+
+namespace {
+    const int CALLS = 200000;
+
+    // The old logger
+    std::vector<String> logBuffer;
+    const size_t maxLogSize = 1024;
+
+    void AddToLog(const String& message) {
+        String logEntry = getCurrentTimestamp() + ": " + message;
+        logBuffer.push_back(logEntry);
+
+        size_t totalSize = 0;
+        for (const String& entry : logBuffer) {
+            totalSize += entry.length();
+        }
+        while (totalSize > maxLogSize && !logBuffer.empty()) {
+            totalSize -= logBuffer.front().length();
+            logBuffer.erase(logBuffer.begin());
+        }
+    }
+
+    template <typename F>
+    double nanosecondsPerCall(F call) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < CALLS; ++i) {
+            call(i);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration<double, std::nano>(elapsed).count() / CALLS;
+    }
+
+    void compare(const char* name, double logMacro, double addToLog) {
+        std::printf("%-24s LOG_* %7.1f ns   AddToLog %7.1f ns   %5.1fx\n", name, logMacro, addToLog, addToLog / logMacro);
+    }
+
+    String lastEntry() {
+        JsonDocument doc;
+        getLog(doc, 1);
+        CHECK(doc.items.size() == 1);
+        return doc.items[0];
+    }
+
+    bool endsWith(const String& text, const char* suffix) {
+        size_t length = std::strlen(suffix);
+        return text.length() >= length && std::strcmp(text.c_str() + text.length() - length, suffix) == 0;
+    }
+
+    void checkTruncation() {
+        LOG_INFO(WIFI_CONNECTING, "short");
+        CHECK(endsWith(lastEntry(), "Attempting to connect to WiFi: short"));
+
+        // 31 characters fit with the terminator, 32 do not
+        LOG_INFO(WIFI_CONNECTING, "0123456789012345678901234567890");
+        CHECK(endsWith(lastEntry(), ": 0123456789012345678901234567890"));
+        LOG_INFO(WIFI_CONNECTING, "01234567890123456789012345678901");
+        CHECK(endsWith(lastEntry(), ": 0123456789012345678901234567890..."));
+
+        // A string with no text space left still takes its argument slot
+        LogRecord record;
+        record.argCount = 0;
+        size_t textPos = 0;
+        appendLogArg(record, textPos, "01234567890123456789012345678901234");
+        appendLogArg(record, textPos, "lost");
+        appendLogArg(record, textPos, 7u);
+        CHECK(record.argCount == 3);
+        CHECK(record.args[1] == (LOG_TEXT_SIZE | LOG_TEXT_TRUNCATED));
+        CHECK(record.args[2] == 7);
+    }
+}
+
+int main() {
+    initLog();
+    checkTruncation();
+
+    String ssid = "TrainLayout-Basement";
+    double macro, old;
+
+    macro = nanosecondsPerCall([](int) { LOG_INFO(PINS_INITIALIZED); });
+    old = nanosecondsPerCall([](int) { AddToLog("Pins initialized."); });
+    compare("no arguments", macro, old);
+
+    macro = nanosecondsPerCall([&](int) { LOG_INFO(WIFI_CONNECTING, ssid); });
+    old = nanosecondsPerCall([&](int) { AddToLog("Attempting to connect to WiFi: " + ssid); });
+    compare("one string", macro, old);
+
+    macro = nanosecondsPerCall([](int i) { LOG_INFO(PIN_DESIGNATION_UPDATED, i & 7, i & 3, i & 1); });
+    old = nanosecondsPerCall([](int i) {
+        AddToLog(String(i & 7) + " attached, " + String(i & 3) + " detached, " + String(i & 1) + " resized.");
+    });
+    compare("three numbers", macro, old);
+
+    // The formatting moved to the reader, /log and the serial drain pay it later
+    double format = nanosecondsPerCall([](int) {
+        JsonDocument doc;
+        getLog(doc, 1);
+    });
+    std::printf("%-24s %7.1f ns per record, deferred to /log and the serial drain\n", "formatLogRecord", format);
+    return 0;
+}
@@ -0,0 +1,351 @@
+// ota_pipeline_test.cpp
+// The decode path of POST /update without the flash: gzip from the host zlib goes
+// through Inflater, optionally into DeltaPatcher, and must come out byte for byte.
+// Every case is fed in one-byte chunks and in random chunks, like TCP segments
+// arriving at handleUpload. Corrupt and truncated streams must fail, never pass.
+// Ends with the time and peak heap of the pipeline for a 1 MB image.
+#include "inflater.h"
+#include "delta_patch.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::exit(1); \
+        } \
+    } while (0)
+
+// Track the heap so the benchmark can report the pipeline's peak
+namespace {
+    size_t liveBytes = 0;
+    size_t peakBytes = 0;
+    const size_t HEADER = alignof(std::max_align_t);
+}
+
+void* operator new(size_t size) {
+    char* block = static_cast<char*>(std::malloc(size + HEADER));
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<size_t*>(block) = size;
+    liveBytes += size;
+    peakBytes = std::max(peakBytes, liveBytes);
+    return block + HEADER;
+}
+
+void operator delete(void* pointer) noexcept {
+    if (pointer == nullptr) {
+        return;
+    }
+    char* block = static_cast<char*>(pointer) - HEADER;
+    liveBytes -= *reinterpret_cast<size_t*>(block);
+    std::free(block);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* pointer) noexcept { operator delete(pointer); }
+void operator delete(void* pointer, size_t) noexcept { operator delete(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { operator delete(pointer); }
+
+
+namespace {
+    typedef std::vector<uint8_t> Bytes;
+
+    // Firmware-like content: code-ish runs that compress, tables, and random data that does not
+    Bytes makeImage(size_t size, uint32_t seed) {
+        std::mt19937 rng(seed);
+        Bytes image;
+        image.reserve(size);
+        while (image.size() < size) {
+            size_t run = 1 + rng() % 2048;
+            switch (rng() % 3) {
+                case 0:
+                    for (size_t i = 0; i < run; ++i) {
+                        image.push_back(static_cast<uint8_t>(rng()));
+                    }
+                    break;
+                case 1:
+                    for (size_t i = 0; i < run; ++i) {
+                        image.push_back(static_cast<uint8_t>(i * 7 + (i >> 5)));
+                    }
+                    break;
+                default:
+                    if (image.size() > 64) {
+                        size_t from = rng() % (image.size() - 32);
+                        for (size_t i = 0; i < run; ++i) {
+                            image.push_back(image[from + i % 32]);
+                        }
+                    }
+                    break;
+            }
+        }
+        image.resize(size);
+        return image;
+    }
+
+    Bytes gzip(const Bytes& data, int level, int strategy) {
+        z_stream stream = {};
+        CHECK(deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, strategy) == Z_OK);
+        Bytes out(deflateBound(&stream, data.size()) + 64);
+        stream.next_in = const_cast<uint8_t*>(data.data());
+        stream.avail_in = data.size();
+        stream.next_out = out.data();
+        stream.avail_out = out.size();
+        CHECK(deflate(&stream, Z_FINISH) == Z_STREAM_END);
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+        return out;
+    }
+
+    void putU32(Bytes& out, uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    // A new image that keeps most of the old one, and the delta in MakeDelta.py's format
+    void makeDelta(const Bytes& source, uint32_t seed, Bytes& target, Bytes& delta) {
+        std::mt19937 rng(seed);
+        target.clear();
+        delta.assign({'T', 'C', 'D', 'E', 'L', 'T', 'A', '1'});
+        size_t targetSizeAt = delta.size();
+        putU32(delta, 0);
+        while (target.size() < source.size()) {
+            if (rng() % 3 != 0) {
+                uint32_t offset = rng() % source.size();
+                uint32_t length = std::min<uint32_t>(1 + rng() % 20000, source.size() - offset);
+                delta.push_back('C');
+                putU32(delta, offset);
+                putU32(delta, length);
+                target.insert(target.end(), source.begin() + offset, source.begin() + offset + length);
+            } else {
+                uint32_t length = 1 + rng() % 3000;
+                delta.push_back('I');
+                putU32(delta, length);
+                for (uint32_t i = 0; i < length; ++i) {
+                    uint8_t byte = static_cast<uint8_t>(rng());
+                    delta.push_back(byte);
+                    target.push_back(byte);
+                }
+            }
+        }
+        delta.push_back('E');
+        uint32_t size = target.size();
+        std::memcpy(&delta[targetSizeAt], &size, 4);
+    }
+
+    // Chunk sizes: 0 means one byte at a time, otherwise random up to maxChunk
+    struct Feeder {
+        std::mt19937 rng;
+        size_t maxChunk;
+
+        Feeder(uint32_t seed, size_t maxChunk) : rng(seed), maxChunk(maxChunk) {}
+        size_t next(size_t remaining) {
+            size_t chunk = maxChunk == 0 ? 1 : 1 + rng() % maxChunk;
+            return std::min(chunk, remaining);
+        }
+    };
+
+    Inflater::Status inflate(const Bytes& compressed, Feeder feeder, Bytes& out) {
+        out.clear();
+        Inflater inflater([&](const uint8_t* data, size_t len) {
+            out.insert(out.end(), data, data + len);
+            return true;
+        });
+        Inflater::Status status = Inflater::NEED_INPUT;
+        for (size_t pos = 0; pos < compressed.size() && status == Inflater::NEED_INPUT;) {
+            size_t chunk = feeder.next(compressed.size() - pos);
+            status = inflater.write(compressed.data() + pos, chunk);
+            pos += chunk;
+        }
+        return status;
+    }
+
+    // gzip -> Inflater -> DeltaPatcher, as handleUpload wires them
+    DeltaPatcher::Status patch(const Bytes& source, const Bytes& compressedDelta, Feeder feeder, Bytes& out) {
+        out.clear();
+        DeltaPatcher patcher(
+            [&](uint32_t offset, uint8_t* buffer, size_t len) {
+                if (offset + len > source.size()) {
+                    return false;
+                }
+                std::memcpy(buffer, source.data() + offset, len);
+                return true;
+            },
+            [&](const uint8_t* data, size_t len) {
+                out.insert(out.end(), data, data + len);
+                return true;
+            });
+        DeltaPatcher::Status patcherStatus = DeltaPatcher::NEED_INPUT;
+        Inflater inflater([&](const uint8_t* data, size_t len) {
+            patcherStatus = patcher.write(data, len);
+            return patcherStatus != DeltaPatcher::FAILED;
+        });
+        Inflater::Status status = Inflater::NEED_INPUT;
+        for (size_t pos = 0; pos < compressedDelta.size() && status == Inflater::NEED_INPUT;) {
+            size_t chunk = feeder.next(compressedDelta.size() - pos);
+            status = inflater.write(compressedDelta.data() + pos, chunk);
+            pos += chunk;
+        }
+        return status == Inflater::DONE ? patcherStatus : DeltaPatcher::FAILED;
+    }
+
+    void testRoundTrips() {
+        const int levels[] = {0, 1, 6, 9};
+        const int strategies[] = {Z_DEFAULT_STRATEGY, Z_FIXED, Z_HUFFMAN_ONLY, Z_RLE};
+        const size_t sizes[] = {0, 1, 100, 70000, 300000};
+        int cases = 0;
+        for (size_t size : sizes) {
+            Bytes image = makeImage(size, size);
+            for (int level : levels) {
+                for (int strategy : strategies) {
+                    Bytes compressed = gzip(image, level, strategy);
+                    Bytes out;
+                    if (size <= 70000) {
+                        CHECK(inflate(compressed, Feeder(0, 0), out) == Inflater::DONE);
+                        CHECK(out == image);
+                    }
+                    for (uint32_t seed = 0; seed < 4; ++seed) {
+                        CHECK(inflate(compressed, Feeder(seed, seed < 2 ? 64 : 5000), out) == Inflater::DONE);
+                        CHECK(out == image);
+                        cases++;
+                    }
+                }
+            }
+        }
+        std::printf("inflate: %d round trips passed\n", cases);
+    }
+
+    void testBrokenStreams() {
+        Bytes image = makeImage(50000, 7);
+        Bytes compressed = gzip(image, 6, Z_DEFAULT_STRATEGY);
+        Bytes out;
+
+        Bytes badCrc = compressed;
+        badCrc[badCrc.size() - 6] ^= 0x01; // In the CRC32 of the trailer
+        CHECK(inflate(badCrc, Feeder(1, 1000), out) == Inflater::FAILED);
+
+        Bytes badMagic = compressed;
+        badMagic[0] = 0x1E;
+        CHECK(inflate(badMagic, Feeder(1, 1000), out) == Inflater::FAILED);
+
+        Bytes truncated(compressed.begin(), compressed.end() - 100);
+        CHECK(inflate(truncated, Feeder(1, 1000), out) == Inflater::NEED_INPUT);
+
+        // Flipped bits in the data must never produce a DONE with the wrong output
+        std::mt19937 rng(3);
+        for (int i = 0; i < 200; ++i) {
+            Bytes corrupt = compressed;
+            corrupt[10 + rng() % (corrupt.size() - 18)] ^= static_cast<uint8_t>(1 << (rng() % 8));
+            if (inflate(corrupt, Feeder(i, 2000), out) == Inflater::DONE) {
+                CHECK(out == image);
+            }
+        }
+        std::printf("inflate: corrupt and truncated streams rejected\n");
+    }
+
+    void testDelta() {
+        Bytes source = makeImage(400000, 11);
+        for (uint32_t seed = 0; seed < 6; ++seed) {
+            Bytes target, delta, out;
+            makeDelta(source, seed, target, delta);
+            Bytes compressed = gzip(delta, 6, Z_DEFAULT_STRATEGY);
+            CHECK(patch(source, compressed, Feeder(seed, seed == 0 ? 16 : 4000), out) == DeltaPatcher::DONE);
+            CHECK(out == target);
+        }
+
+        Bytes target, delta, out;
+        makeDelta(source, 99, target, delta);
+
+        Bytes wrongSize = delta;
+        wrongSize[8] ^= 0x01;
+        CHECK(patch(source, gzip(wrongSize, 6, Z_DEFAULT_STRATEGY), Feeder(1, 4000), out) == DeltaPatcher::FAILED);
+
+        Bytes noEnd(delta.begin(), delta.end() - 1);
+        CHECK(patch(source, gzip(noEnd, 6, Z_DEFAULT_STRATEGY), Feeder(1, 4000), out) == DeltaPatcher::NEED_INPUT);
+
+        Bytes outOfRange = {'T', 'C', 'D', 'E', 'L', 'T', 'A', '1'};
+        putU32(outOfRange, 100);
+        outOfRange.push_back('C');
+        putU32(outOfRange, source.size() - 50);
+        putU32(outOfRange, 100);
+        outOfRange.push_back('E');
+        CHECK(patch(source, gzip(outOfRange, 6, Z_DEFAULT_STRATEGY), Feeder(1, 4000), out) == DeltaPatcher::FAILED);
+
+        std::printf("delta: 6 patches round tripped, bad deltas rejected\n");
+    }
+
+    // A 1 MB image in TCP-sized chunks, like an upload of the current firmware
+    void benchmark() {
+        const size_t IMAGE_SIZE = 1 << 20;
+        const size_t CHUNK = 1436;
+        Bytes image = makeImage(IMAGE_SIZE, 42);
+        Bytes compressed = gzip(image, 9, Z_DEFAULT_STRATEGY);
+        Bytes target, delta;
+        makeDelta(image, 42, target, delta);
+        Bytes compressedDelta = gzip(delta, 9, Z_DEFAULT_STRATEGY);
+
+        // Count only what the pipeline itself holds, not the test's buffers
+        size_t written = 0;
+        size_t baseline = liveBytes;
+        peakBytes = liveBytes;
+        auto start = std::chrono::steady_clock::now();
+        {
+            Inflater inflater([&](const uint8_t*, size_t len) {
+                written += len;
+                return true;
+            });
+            for (size_t pos = 0; pos < compressed.size(); pos += CHUNK) {
+                inflater.write(compressed.data() + pos, std::min(CHUNK, compressed.size() - pos));
+            }
+        }
+        double gzipMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        size_t gzipPeak = peakBytes - baseline;
+        CHECK(written == IMAGE_SIZE);
+
+        written = 0;
+        baseline = liveBytes;
+        peakBytes = liveBytes;
+        start = std::chrono::steady_clock::now();
+        {
+            DeltaPatcher patcher(
+                [&](uint32_t offset, uint8_t* buffer, size_t len) {
+                    std::memcpy(buffer, image.data() + offset, len);
+                    return true;
+                },
+                [&](const uint8_t*, size_t len) {
+                    written += len;
+                    return true;
+                });
+            Inflater inflater([&](const uint8_t* data, size_t len) {
+                return patcher.write(data, len) != DeltaPatcher::FAILED;
+            });
+            for (size_t pos = 0; pos < compressedDelta.size(); pos += CHUNK) {
+                inflater.write(compressedDelta.data() + pos, std::min(CHUNK, compressedDelta.size() - pos));
+            }
+        }
+        double deltaMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        size_t deltaPeak = peakBytes - baseline;
+        CHECK(written == target.size());
+
+        std::printf("1 MB image, gzip %zu bytes: %.1f ms, peak heap %zu bytes\n", compressed.size(), gzipMs, gzipPeak);
+        std::printf("1 MB image, gzip+delta %zu bytes: %.1f ms, peak heap %zu bytes\n", compressedDelta.size(), deltaMs, deltaPeak);
+    }
+}
+
+int main() {
+    testRoundTrips();
+    testBrokenStreams();
+    testDelta();
+    benchmark();
+    return 0;
+}
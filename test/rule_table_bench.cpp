@@ -0,0 +1,140 @@
+// rule_table_bench.cpp
+// RuleTable dispatch: correctness of the compiled slots (upload order within a slot,
+// CHANGE rules on both edges, limits), then events per second and per-event latency
+// for 500 rules, spread over 20 sensors and all on one pin as the worst case.
+#include "rule_table.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::exit(1); \
+        } \
+    } while (0)
+
+namespace {
+    volatile int32_t outputs[256]; // Stands in for the apply functions
+
+    void apply(const RuleAction& action) {
+        outputs[action.pin & 0xFF] = action.value;
+    }
+
+    void testDispatch() {
+        RuleTable table;
+        RuleAction digital = {RuleAction::DIGITAL, 7, 1};
+        RuleAction pwm = {RuleAction::PWM, 5, 40};
+        RuleAction servo = {RuleAction::SERVO, 4, 100};
+        CHECK(table.add(2, RuleTable::RISING, &digital, 1));
+        CHECK(table.add(3, RuleTable::CHANGE, &pwm, 1));
+        CHECK(table.add(2, RuleTable::CHANGE, &servo, 1));
+        CHECK(!table.add(RuleTable::MAX_SOURCES, RuleTable::RISING, &digital, 1));
+        CHECK(table.actionsFor(2, true).size() == 0); // Not compiled yet
+
+        table.compile();
+        RuleTable::Span span = table.actionsFor(2, true);
+        CHECK(span.size() == 2 && span.first[0].pin == 7 && span.first[1].pin == 4); // Upload order
+        span = table.actionsFor(2, false);
+        CHECK(span.size() == 1 && span.first[0].pin == 4);
+        CHECK(table.actionsFor(3, true).size() == 1 && table.actionsFor(3, false).size() == 1);
+        CHECK(table.actionsFor(9, true).size() == 0 && table.actionsFor(200, true).size() == 0);
+        CHECK(table.compiledSize() == 5); // The CHANGE rules count twice
+
+        // A copy owns its own dispatch table, rules reach the control task as copies
+        RuleTable copy = table;
+        CHECK(copy.actionsFor(2, true).first != table.actionsFor(2, true).first);
+        CHECK(copy.actionsFor(2, true).size() == 2);
+
+        // Limits
+        RuleTable full;
+        std::vector<RuleAction> many(RuleTable::MAX_ACTIONS / RuleTable::MAX_RULES, digital);
+        for (size_t i = 0; i < RuleTable::MAX_RULES; ++i) {
+            CHECK(full.add(i % RuleTable::MAX_SOURCES, RuleTable::RISING, many.data(), many.size()));
+        }
+        CHECK(!full.add(0, RuleTable::RISING, &digital, 1));
+        full.compile();
+        CHECK(full.compiledSize() == RuleTable::MAX_ACTIONS);
+
+        std::printf("dispatch: slots, order, copies and limits ok\n");
+    }
+
+    void run(const char* name, const RuleTable& table, int sources) {
+        const int EVENTS = 2000000;
+        const int TIMED = 200000;
+        std::mt19937 rng(1);
+        std::vector<uint8_t> source(EVENTS);
+        std::vector<uint8_t> rising(EVENTS);
+        for (int i = 0; i < EVENTS; ++i) {
+            source[i] = rng() % sources;
+            rising[i] = rng() & 1;
+        }
+
+        size_t actions = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < EVENTS; ++i) {
+            RuleTable::Span span = table.actionsFor(source[i], rising[i]);
+            for (const RuleAction& action : span) {
+                apply(action);
+            }
+            actions += span.size();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<double> latencies;
+        latencies.reserve(TIMED);
+        for (int i = 0; i < TIMED; ++i) {
+            auto eventStart = std::chrono::steady_clock::now();
+            for (const RuleAction& action : table.actionsFor(source[i], rising[i])) {
+                apply(action);
+            }
+            latencies.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - eventStart).count());
+        }
+        std::sort(latencies.begin(), latencies.end());
+        std::printf("%-26s %6.2f M events/s, %6.1f actions/event, p50 %6.0f ns, p99 %6.0f ns, worst %7.0f ns\n",
+                    name, EVENTS / seconds / 1e6, double(actions) / EVENTS,
+                    latencies[TIMED / 2], latencies[TIMED * 99 / 100], latencies.back());
+    }
+
+    void benchmark() {
+        std::mt19937 rng(7);
+
+        // 500 rules over 20 sensors, 1-3 actions each
+        RuleTable spread;
+        for (int rule = 0; rule < 500; ++rule) {
+            RuleAction actions[3];
+            int count = 1 + rng() % 3;
+            for (int i = 0; i < count; ++i) {
+                actions[i] = {RuleAction::Type(rng() % 4), int16_t(rng() % 22), int32_t(rng() % 2)};
+            }
+            CHECK(spread.add(rng() % 20, RuleTable::Edge(rng() % 3), actions, count));
+        }
+        auto start = std::chrono::steady_clock::now();
+        spread.compile();
+        double compileUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        std::printf("compile 500 rules: %.1f us, %zu table entries\n", compileUs, spread.compiledSize());
+        run("500 rules, 20 sensors", spread, 20);
+
+        // Worst case: every rule on one pin for both edges, 4 actions each, 2000 actions per event
+        RuleTable worst;
+        for (int rule = 0; rule < 500; ++rule) {
+            RuleAction actions[4];
+            for (int i = 0; i < 4; ++i) {
+                actions[i] = {RuleAction::DIGITAL, int16_t(rng() % 22), 1};
+            }
+            CHECK(worst.add(0, RuleTable::CHANGE, actions, 4));
+        }
+        worst.compile();
+        run("500 rules, all on 1 pin", worst, 1);
+    }
+}
+
+int main() {
+    testDispatch();
+    benchmark();
+    return 0;
+}
@@ -0,0 +1,159 @@
+// strip_buffers_test.cpp
+// Runs 10k random reconfigurations through StripBuffers::rebuild the way
+// applyPinDesignation does (rebuild, swap, release retired) and checks that no
+// buffer is leaked, that kept strips keep their buffer and that colors survive a resize.
+// A pin listed twice must not make two strips share a buffer.
+#include "strip_buffers.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::exit(1); \
+        } \
+    } while (0)
+
+// Count live bytes of every array allocation
+namespace {
+    size_t liveBytes = 0;
+    size_t liveBlocks = 0;
+    const size_t HEADER = alignof(std::max_align_t);
+}
+
+void* operator new[](size_t size) {
+    char* block = static_cast<char*>(std::malloc(size + HEADER));
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<size_t*>(block) = size;
+    liveBytes += size;
+    liveBlocks++;
+    return block + HEADER;
+}
+
+void operator delete[](void* pointer) noexcept {
+    if (pointer == nullptr) {
+        return;
+    }
+    char* block = static_cast<char*>(pointer) - HEADER;
+    liveBytes -= *reinterpret_cast<size_t*>(block);
+    liveBlocks--;
+    std::free(block);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    operator delete[](pointer);
+}
+
+
+namespace {
+    struct Pixel {
+        uint8_t r, g, b;
+    };
+
+    // The current designation, like the fastLed globals in input_config
+    std::vector<int> pins;
+    std::vector<Pixel*> leds;
+    std::vector<int> counts;
+    std::vector<std::string> types;
+
+    uint8_t colorOf(int pin, int led) {
+        return uint8_t(pin * 31 + led);
+    }
+
+    // postPinDesignation rejects a repeated pin, rebuild still must not hand one buffer to two strips
+    void testRepeatedPin() {
+        std::vector<int> oldPins = {5};
+        std::vector<Pixel*> oldLeds = {StripBuffers::allocate<Pixel>(10)};
+        std::vector<int> oldCounts = {10};
+        std::vector<std::string> oldTypes = {"WS2812"};
+        oldLeds[0][3] = {7, 8, 9};
+
+        StripBuffers::Rebuild<Pixel> strips = StripBuffers::rebuild(oldPins, oldLeds, oldCounts, oldTypes,
+                                                                    std::vector<int>{5, 5}, std::vector<int>{0, 0}, 60, "WS2812");
+        CHECK(strips.leds.size() == 2 && strips.leds[0] != strips.leds[1]);
+        CHECK(strips.leds[0] == oldLeds[0] && strips.retired.empty());
+        CHECK(strips.counts[1] == 10 && strips.leds[1][3].r == 7 && strips.leds[1][3].b == 9);
+
+        // Both go on the next rebuild, each freed once
+        StripBuffers::Rebuild<Pixel> cleared = StripBuffers::rebuild(std::vector<int>{5, 5}, strips.leds, strips.counts, strips.types,
+                                                                     std::vector<int>{}, std::vector<int>{}, 60, "WS2812");
+        CHECK(cleared.retired.size() == 2);
+        StripBuffers::release(cleared.retired);
+        CHECK(liveBytes == 0 && liveBlocks == 0);
+        std::printf("strip_buffers: a repeated pin gets its own buffer\n");
+    }
+}
+
+
+int main() {
+    testRepeatedPin();
+
+    std::mt19937 rng(12345);
+    const int ITERATIONS = 10000;
+    size_t attached = 0, detached = 0, resized = 0;
+
+    for (int iteration = 0; iteration < ITERATIONS; ++iteration) {
+        // A random subset of 13 pins, each with a random or unchanged count
+        std::vector<int> newPins;
+        std::vector<int> requested;
+        for (int pin = 0; pin < 13; ++pin) {
+            if (rng() % 3 == 0) {
+                newPins.push_back(pin);
+                requested.push_back(rng() % 4 == 0 ? 0 : 1 + rng() % 300);
+            }
+        }
+
+        StripBuffers::Rebuild<Pixel> strips = StripBuffers::rebuild(pins, leds, counts, types, newPins, requested, 60, "WS2812");
+        CHECK(strips.leds.size() == newPins.size() && strips.counts.size() == newPins.size());
+
+        for (size_t i = 0; i < newPins.size(); ++i) {
+            auto it = std::find(pins.begin(), pins.end(), newPins[i]);
+            CHECK(strips.counts[i] == (requested[i] > 0 ? requested[i] : (it != pins.end() ? counts[it - pins.begin()] : 60)));
+            if (it == pins.end()) {
+                for (int led = 0; led < strips.counts[i]; ++led) {
+                    CHECK(strips.leds[i][led].r == 0 && strips.leds[i][led].g == 0 && strips.leds[i][led].b == 0);
+                }
+            } else {
+                size_t old = it - pins.begin();
+                CHECK((strips.leds[i] == leds[old]) == (strips.counts[i] == counts[old]));
+                for (int led = 0; led < std::min(strips.counts[i], counts[old]); ++led) {
+                    CHECK(strips.leds[i][led].r == colorOf(newPins[i], led));
+                }
+            }
+        }
+
+        pins.swap(newPins);
+        leds.swap(strips.leds);
+        counts.swap(strips.counts);
+        types.swap(strips.types);
+        StripBuffers::release(strips.retired);
+        attached += strips.attached;
+        detached += strips.detached;
+        resized += strips.resized;
+
+        // Paint every strip so copies can be checked next time
+        for (size_t i = 0; i < pins.size(); ++i) {
+            for (int led = 0; led < counts[i]; ++led) {
+                leds[i][led] = {colorOf(pins[i], led), 0, 0};
+            }
+        }
+
+        size_t expected = 0;
+        for (int count : counts) {
+            expected += count * sizeof(Pixel);
+        }
+        CHECK(liveBytes == expected && liveBlocks == leds.size());
+    }
+
+    StripBuffers::release(leds);
+    CHECK(liveBytes == 0 && liveBlocks == 0);
+    std::printf("strip_buffers: %d reconfigurations (%zu attached, %zu detached, %zu resized), 0 bytes leaked\n",
+                ITERATIONS, attached, detached, resized);
+    return 0;
+}
@@ -0,0 +1,56 @@
+// Arduino.h host stub
+// Just enough of the Arduino core to build the logging module on a PC: a String
+// over std::string, millis(), Serial and the FreeRTOS critical section macros.
+#ifndef HOST_STUB_ARDUINO_H
+#define HOST_STUB_ARDUINO_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+class String {
+public:
+    String() = default;
+    String(const char* text) : value(text) {}
+    String(const std::string& text) : value(text) {}
+    String(char c) : value(1, c) {}
+    String(int number) : value(std::to_string(number)) {}
+    String(unsigned int number) : value(std::to_string(number)) {}
+    String(long number) : value(std::to_string(number)) {}
+    String(unsigned long number) : value(std::to_string(number)) {}
+
+    const char* c_str() const { return value.c_str(); }
+    unsigned int length() const { return value.size(); }
+    bool reserve(unsigned int size) { value.reserve(size); return true; }
+
+    String& operator+=(const String& other) { value += other.value; return *this; }
+    String& operator+=(const char* other) { value += other; return *this; }
+    String& operator+=(char c) { value += c; return *this; }
+    bool operator==(const String& other) const { return value == other.value; }
+
+    friend String operator+(const String& left, const String& right) { return String(left.value + right.value); }
+    friend String operator+(const String& left, const char* right) { return String(left.value + right); }
+    friend String operator+(const char* left, const String& right) { return String(left + right.value); }
+
+private:
+    std::string value;
+};
+
+inline unsigned long millis() {
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct HostSerial {
+    void println(const String& line) { std::puts(line.c_str()); }
+};
+inline HostSerial Serial;
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+#endif
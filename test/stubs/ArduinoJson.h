@@ -0,0 +1,29 @@
+// ArduinoJson.h host stub
+// Only the array building used by getLog.
+#ifndef HOST_STUB_ARDUINOJSON_H
+#define HOST_STUB_ARDUINOJSON_H
+
+#include <Arduino.h>
+#include <vector>
+
+class JsonArray {
+public:
+    explicit JsonArray(std::vector<String>* items) : items(items) {}
+    bool add(const String& item) { items->push_back(item); return true; }
+
+private:
+    std::vector<String>* items;
+};
+
+class JsonDocument {
+public:
+    template <typename T>
+    T to() {
+        items.clear();
+        return T(&items);
+    }
+
+    std::vector<String> items;
+};
+
+#endif
@@ -0,0 +1,16 @@
+// IPAddress.h host stub
+#ifndef HOST_STUB_IPADDRESS_H
+#define HOST_STUB_IPADDRESS_H
+
+#include <cstdint>
+
+class IPAddress {
+public:
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets{a, b, c, d} {}
+    uint8_t operator[](int index) const { return octets[index]; }
+
+private:
+    uint8_t octets[4];
+};
+
+#endif
@@ -0,0 +1,7 @@
+// esp_attr.h host stub
+#ifndef HOST_STUB_ESP_ATTR_H
+#define HOST_STUB_ESP_ATTR_H
+
+#define RTC_NOINIT_ATTR
+
+#endif
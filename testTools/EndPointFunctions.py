@@ -3,10 +3,10 @@ import json
 
 
 #### 1. Pin Designation
-def get_pin_designation(base_url):
+def get_pin_designation(base_url, timeout=None):
     url = f"{base_url}/pinDesignation"
     try:
-        response = requests.get(url)
+        response = requests.get(url, timeout=timeout)
         response.raise_for_status()
         return response.json()
     except requests.exceptions.RequestException as e:
@@ -17,7 +17,8 @@ def post_pin_designation(base_url, data):
     url = f"{base_url}/pinDesignation"
     try:
         response = requests.post(url, data={'body': json.dumps(data)})
-        response.raise_for_status()
+        if response.status_code != 400:  # A 400 carries the validation errors
+            response.raise_for_status()
         return response.json()
     except requests.exceptions.RequestException as e:
         print(f"POST /pinDesignation failed: {e}")
@@ -110,7 +111,81 @@ def get_device_info(base_url):
         print(f"GET /device failed: {e}")
         return None
 
-#### 7. Server Status
+#### 7. Heap and Uptime
+def get_status(base_url, timeout=None):
+    url = f"{base_url}/status"
+    try:
+        response = requests.get(url, timeout=timeout)
+        response.raise_for_status()
+        return response.json()
+    except requests.exceptions.RequestException as e:
+        print(f"GET /status failed: {e}")
+        return None
+
+def get_latency_profile(base_url):
+    url = f"{base_url}/latencyProfile"
+    try:
+        response = requests.get(url)
+        response.raise_for_status()
+        return response.json()
+    except requests.exceptions.RequestException as e:
+        print(f"GET /latencyProfile failed: {e}")
+        return None
+
+def post_latency_profile(base_url, data):
+    url = f"{base_url}/latencyProfile"
+    try:
+        response = requests.post(url, data={'body': json.dumps(data)})
+        response.raise_for_status()
+        return response.json()
+    except requests.exceptions.RequestException as e:
+        print(f"POST /latencyProfile failed: {e}")
+        return None
+
+def get_ping(base_url, client_time, last_rtt=None, client_id=None, session=None):
+    url = f"{base_url}/ping"
+    params = {'t': client_time}
+    if last_rtt is not None:
+        params['rtt'] = f"{last_rtt:.1f}"
+    if client_id is not None:
+        params['id'] = client_id
+    try:
+        response = (session or requests).get(url, params=params)
+        response.raise_for_status()
+        return response.json()
+    except requests.exceptions.RequestException as e:
+        print(f"GET /ping failed: {e}")
+        return None
+
+def get_rules(base_url, offset=0):
+    url = f"{base_url}/rules"
+    try:
+        response = requests.get(url, params={'offset': offset})
+        response.raise_for_status()
+        return response.json()
+    except requests.exceptions.RequestException as e:
+        print(f"GET /rules failed: {e}")
+        return None
+
+def post_rules(base_url, rules, batch_size=40):
+    # Large rule sets go in batches, every batch after the first is appended
+    url = f"{base_url}/rules"
+    result = None
+    for start in range(0, max(len(rules), 1), batch_size):
+        data = {'append': start > 0, 'rules': rules[start:start + batch_size]}
+        try:
+            response = requests.post(url, data={'body': json.dumps(data)})
+            if response.status_code != 400:  # A 400 carries the validation errors
+                response.raise_for_status()
+            result = response.json()
+        except requests.exceptions.RequestException as e:
+            print(f"POST /rules failed: {e}")
+            return None
+        if 'error' in result:
+            return result
+    return result
+
+#### 8. Server Status
 def get_server_status(base_url):
     url = f"{base_url}/test"
     try:
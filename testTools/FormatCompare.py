@@ -0,0 +1,139 @@
+"""Compare JSON and MessagePack on the train controller REST API.
+
+Fetches every read-only endpoint in both formats and re-posts the current digital
+and LED values, then prints the payload sizes and median round trip per format next
+to the parse and serialize times the device measured (GET /status "formats").
+
+--examples needs no device: it encodes documents shaped like the firmware's replies
+(8 digital, 4 PWM, 2 LED strips, 1 throttle, 2 servos, 4 sensors, 1 expander) and prints
+their size in both formats. Sizes only; parse and serialize times need a device.
+
+Needs the msgpack package: pip install msgpack
+
+Examples:
+    python FormatCompare.py --host esp32-controller
+    python FormatCompare.py --host 192.168.1.150 --repeat 50
+    python FormatCompare.py --examples
+"""
+import argparse
+import json
+import time
+
+import msgpack
+import requests
+
+GET_PATHS = ["/pinValues", "/pinDesignation", "/network", "/status", "/update", "/log?limit=10"]
+MSGPACK = "application/msgpack"
+
+
+def fetch(session, url, accept):
+    start = time.perf_counter()
+    response = session.get(url, headers={"Accept": accept})
+    elapsed = (time.perf_counter() - start) * 1000
+    response.raise_for_status()
+    data = msgpack.unpackb(response.content) if accept == MSGPACK else json.loads(response.content)
+    return data, len(response.content), elapsed
+
+
+def pin_values_body(values):
+    """Turn a GET /pinValues reply into a POST /pinValues body that writes the same values.
+    PWM is left out, GET reports the raw duty while POST takes a percentage."""
+    return {
+        "digital": values.get("digitalPins", {}),
+        "fastLed": {str(led["pin"]): dict(zip("rgb", led["color"])) for led in values.get("fastLedPins", [])},
+    }
+
+
+def example_documents():
+    """Documents with the keys and value types the firmware sends, for --examples."""
+    pin_values = {
+        "digitalPins": {str(pin): pin % 2 for pin in (0, 1, 3, 6, 7, 9, 10, 20)},
+        "pwmPins": {str(pin): 128 for pin in (4, 5, 100, 101)},
+        "fastLedPins": [{"pin": pin, "type": "WS2812", "numLeds": 60, "color": [255, 100, 50]} for pin in (8, 21)],
+        "analogPins": {"2": {"raw": 2048, "output": 5, "source": "local"}},
+        "servoPins": {str(pin): {"position": 40, "target": 100, "pulseUs": 1420} for pin in (102, 103)},
+        "sensorPins": {str(pin): 1 for pin in (11, 12, 13, 14)},
+        "expanders": [{"type": "PCA9685", "address": 64, "firstPin": 100, "pins": 16, "transactions": 21230,
+                       "bytes": 382044, "skippedWrites": 4017, "online": True}],
+        "ledPower": {"requestedMa": 3400, "budgetMa": 2000, "scalePercent": 56},
+    }
+    designation = {
+        "digitalPins": [0, 1, 3, 6, 7, 9, 10, 20],
+        "pwmPins": [4, 5, 100, 101],
+        "fastLedPins": [8, 21],
+        "analogPins": [2],
+        "analogBindings": {"2": 5},
+        "servoPins": [102, 103],
+        "servoCalibrations": {str(pin): {"minUs": 1100, "maxUs": 1900, "speed": 20} for pin in (102, 103)},
+        "sensorPins": [11, 12, 13, 14],
+        "reservedPins": [18, 19],
+        "availablePins": list(range(0, 22)) + list(range(100, 116)),
+    }
+    status = {
+        "uptimeMs": 3600000, "freeHeap": 182344, "minFreeHeap": 170112, "maxAllocHeap": 110580,
+        "formats": {name: {"requests": 120, "responses": 410, "avgBytesIn": 88, "avgBytesOut": 190,
+                           "avgParseUs": 140, "avgSerializeUs": 260} for name in ("json", "msgpack")},
+        "servoPoll": {"steps": 1500, "avgUs": 30, "maxUs": 85},
+    }
+    return {
+        "GET /pinValues": pin_values,
+        "GET /pinDesignation": designation,
+        "GET /status": status,
+        "POST /pinValues": pin_values_body({"digitalPins": pin_values["digitalPins"],
+                                            "fastLedPins": pin_values["fastLedPins"]}),
+    }
+
+
+def print_examples():
+    print(f"  {'document':<22}{'json B':>8}{'msgpack B':>11}{'ratio':>7}")
+    for name, document in example_documents().items():
+        json_size = len(json.dumps(document, separators=(",", ":")))  # serializeJson is compact too
+        pack_size = len(msgpack.packb(document))
+        print(f"  {name:<22}{json_size:>8}{pack_size:>11}{pack_size / json_size:>7.0%}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare JSON and MessagePack payloads")
+    parser.add_argument("--host", default="esp32-controller", help="Device hostname or IP")
+    parser.add_argument("--repeat", type=int, default=20, help="Requests per endpoint and format")
+    parser.add_argument("--examples", action="store_true", help="Only print the sizes of example documents, no device")
+    args = parser.parse_args()
+
+    if args.examples:
+        print_examples()
+        return
+
+    base_url = f"http://{args.host}/api/v2"
+    session = requests.Session()
+
+    print(f"  {'endpoint':<20}{'json B':>8}{'msgpack B':>11}{'ratio':>7}{'json ms':>9}{'msgpack ms':>12}")
+    for path in GET_PATHS:
+        row = {}
+        for accept in ("application/json", MSGPACK):
+            times = []
+            for _ in range(args.repeat):
+                data, size, elapsed = fetch(session, base_url + path, accept)
+                times.append(elapsed)
+            times.sort()
+            row[accept] = (size, times[len(times) // 2])
+        json_size, json_ms = row["application/json"]
+        pack_size, pack_ms = row[MSGPACK]
+        print(f"  {path:<20}{json_size:>8}{pack_size:>11}{pack_size / max(json_size, 1):>7.0%}{json_ms:>9.1f}{pack_ms:>12.1f}")
+
+    # Write the current values back, once per format, so the device parses both
+    values, _, _ = fetch(session, base_url + "/pinValues", "application/json")
+    body = pin_values_body(values)
+    for _ in range(args.repeat):
+        session.post(base_url + "/pinValues", data=json.dumps(body), headers={"Content-Type": "application/json"})
+        session.post(base_url + "/pinValues", data=msgpack.packb(body), headers={"Content-Type": MSGPACK})
+    print(f"  POST /pinValues body: json {len(json.dumps(body))} B, msgpack {len(msgpack.packb(body))} B")
+
+    status, _, _ = fetch(session, base_url + "/status", "application/json")
+    print("Device side averages since boot")
+    for name, stats in status.get("formats", {}).items():
+        print(f"  {name:<8} parse {stats['avgParseUs']} us ({stats['requests']} bodies, {stats['avgBytesIn']} B), "
+              f"serialize {stats['avgSerializeUs']} us ({stats['responses']} replies, {stats['avgBytesOut']} B)")
+
+
+if __name__ == "__main__":
+    main()
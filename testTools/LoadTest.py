@@ -0,0 +1,323 @@
+"""Load and soak test for the train controller REST API.
+
+Replays a weighted mix of /pinValues, /pinDesignation, /network and /log requests
+at a fixed concurrency against a device (or anything serving the same routes) and
+reports latency percentiles, throughput and error rates per endpoint.
+
+In soak mode the run is split into windows. Every window prints its own statistics
+together with the heap figures from /status, and the final report shows how
+latency and free heap drifted over the run.
+
+Examples:
+    python LoadTest.py --host esp32-controller --concurrency 4 --duration 60
+    python LoadTest.py --host 192.168.1.150 --soak-hours 8 --window 300 --csv soak.csv
+    python LoadTest.py --host esp32-controller --mix pinValuesGet=10,pinValuesPost=5,log=1
+"""
+import argparse
+import csv
+import json
+import random
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+import requests
+
+from EndPointFunctions import get_pin_designation, get_status
+
+
+# Default traffic mix, roughly what the GUIs and an operator generate
+DEFAULT_MIX = {
+    "pinValuesGet": 40,
+    "pinValuesPost": 35,
+    "pinDesignationGet": 10,
+    "pinDesignationPost": 2,
+    "networkGet": 5,
+    "logGet": 8,
+}
+
+# POST /network writes to flash, so it is only included when asked for
+OPTIONAL_OPERATIONS = ("networkPost",)
+
+
+class Designation:
+    """Current pin designation, used to build valid POST bodies."""
+
+    # Reported by GET /pinDesignation but not part of a POST. The device parses the whole
+    # body into a 1024 byte document, so with expanders these alone can make it fail.
+    READ_ONLY_KEYS = ("reservedPins", "availablePins", "failedPins")
+
+    def __init__(self, data):
+        self.data = dict(data or {})
+        self.digital = self.data.get("digitalPins", [])
+        self.pwm = self.data.get("pwmPins", [])
+        self.fast_led = self.data.get("fastLedPins", [])
+
+    def as_post_body(self):
+        # The GET /pinDesignation document: a role left out of the POST is cleared,
+        # so analog, servo and sensor pins with their bindings and calibrations go back too
+        return {key: value for key, value in self.data.items() if key not in self.READ_ONLY_KEYS}
+
+
+def build_request(operation, designation, rng):
+    """Return (label, method, path, form data) for one operation."""
+    if operation == "pinValuesGet":
+        return "GET /pinValues", "GET", "/pinValues", None
+    if operation == "pinValuesPost":
+        body = {
+            "digital": {str(pin): rng.randint(0, 1) for pin in designation.digital},
+            "pwm": {str(pin): rng.randint(0, 100) for pin in designation.pwm},
+            "fastLed": {str(pin): {"r": rng.randint(0, 255), "g": rng.randint(0, 255), "b": rng.randint(0, 255)}
+                        for pin in designation.fast_led},
+        }
+        return "POST /pinValues", "POST", "/pinValues", {"body": json.dumps(body)}
+    if operation == "pinDesignationGet":
+        return "GET /pinDesignation", "GET", "/pinDesignation", None
+    if operation == "pinDesignationPost":
+        # Re-posting the current designation exercises validation and the diff without changing outputs
+        return "POST /pinDesignation", "POST", "/pinDesignation", {"body": json.dumps(designation.as_post_body())}
+    if operation == "networkGet":
+        return "GET /network", "GET", "/network", None
+    if operation == "networkPost":
+        body = {"ssid": "LoadTestNetwork", "password": "loadtest", "isDefault": False}
+        return "POST /network", "POST", "/network", {"body": json.dumps(body)}
+    if operation == "logGet":
+        return "GET /log", "GET", "/log?limit=10", None
+    raise ValueError(f"Unknown operation: {operation}")
+
+
+def percentile(sorted_values, fraction):
+    if not sorted_values:
+        return float("nan")
+    index = min(len(sorted_values) - 1, int(round(fraction * (len(sorted_values) - 1))))
+    return sorted_values[index]
+
+
+class Stats:
+    """Latencies and error counts for one reporting window, per endpoint."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latencies = {}
+        self.errors = {}
+        self.started = time.monotonic()
+
+    def record(self, label, latency_ms, error):
+        with self.lock:
+            self.latencies.setdefault(label, []).append(latency_ms)
+            if error:
+                counts = self.errors.setdefault(label, {})
+                counts[error] = counts.get(error, 0) + 1
+
+    def summary(self):
+        with self.lock:
+            elapsed = max(time.monotonic() - self.started, 1e-9)
+            rows = {}
+            all_latencies = []
+            for label, values in sorted(self.latencies.items()):
+                values = sorted(values)
+                all_latencies.extend(values)
+                errors = sum(self.errors.get(label, {}).values())
+                rows[label] = self._row(values, errors, elapsed)
+            all_latencies.sort()
+            total_errors = sum(sum(counts.values()) for counts in self.errors.values())
+            rows["ALL"] = self._row(all_latencies, total_errors, elapsed)
+            return rows, {label: dict(counts) for label, counts in self.errors.items()}
+
+    @staticmethod
+    def _row(values, errors, elapsed):
+        count = len(values)
+        return {
+            "requests": count,
+            "throughput": count / elapsed,
+            "errorRate": errors / count if count else 0.0,
+            "p50": percentile(values, 0.50),
+            "p99": percentile(values, 0.99),
+            "p999": percentile(values, 0.999),
+        }
+
+
+def print_summary(title, rows, errors):
+    print(title)
+    print(f"  {'endpoint':<22}{'requests':>9}{'req/s':>9}{'err %':>8}{'p50 ms':>9}{'p99 ms':>9}{'p999 ms':>9}")
+    for label, row in rows.items():
+        print(f"  {label:<22}{row['requests']:>9}{row['throughput']:>9.1f}{row['errorRate'] * 100:>8.2f}"
+              f"{row['p50']:>9.1f}{row['p99']:>9.1f}{row['p999']:>9.1f}")
+    for label, counts in errors.items():
+        print(f"  errors {label}: " + ", ".join(f"{kind}={count}" for kind, count in counts.items()))
+
+
+class LoadGenerator:
+    def __init__(self, base_url, mix, concurrency, timeout, seed):
+        self.base_url = base_url
+        self.concurrency = concurrency
+        self.timeout = timeout
+        self.operations = list(mix.keys())
+        self.weights = list(mix.values())
+        self.seed = seed
+        self.stop_event = threading.Event()
+        self.stats = Stats()
+        self.stats_lock = threading.Lock()
+
+        self.designation = Designation(get_pin_designation(base_url, timeout))
+        if not (self.designation.digital or self.designation.pwm or self.designation.fast_led):
+            print("Warning: no pin designation returned, POST /pinValues will carry empty bodies")
+
+    def swap_stats(self):
+        with self.stats_lock:
+            old, self.stats = self.stats, Stats()
+        return old
+
+    def worker(self, worker_id):
+        rng = random.Random(self.seed + worker_id)
+        session = requests.Session()
+        while not self.stop_event.is_set():
+            operation = rng.choices(self.operations, self.weights)[0]
+            label, method, path, data = build_request(operation, self.designation, rng)
+            error = None
+            start = time.perf_counter()
+            try:
+                response = session.request(method, self.base_url + path, data=data, timeout=self.timeout)
+                if response.status_code != 200:
+                    error = f"http{response.status_code}"
+                elif response.headers.get("Content-Type", "").startswith("application/json"):
+                    payload = response.json()
+                    if isinstance(payload, dict) and ("error" in payload or "errors" in payload):
+                        error = "app"
+            except requests.exceptions.Timeout:
+                error = "timeout"
+            except requests.exceptions.RequestException:
+                error = "transport"
+            except ValueError:
+                error = "badJson"
+            latency_ms = (time.perf_counter() - start) * 1000
+            with self.stats_lock:
+                stats = self.stats
+            stats.record(label, latency_ms, error)
+
+    def run(self, duration, window, on_window):
+        deadline = time.monotonic() + duration
+        with ThreadPoolExecutor(max_workers=self.concurrency) as pool:
+            for worker_id in range(self.concurrency):
+                pool.submit(self.worker, worker_id)
+            try:
+                while time.monotonic() < deadline:
+                    time.sleep(max(0.0, min(window, deadline - time.monotonic())))
+                    on_window(self.swap_stats())
+            finally:
+                self.stop_event.set()
+
+
+def parse_mix(text, include_writes):
+    if not text:
+        mix = dict(DEFAULT_MIX)
+        if include_writes:
+            mix["networkPost"] = 1
+        return mix
+    mix = {}
+    for part in text.split(","):
+        name, weight = part.split("=")
+        name = name.strip()
+        build_request(name, Designation({}), random.Random())  # Validates the name
+        if name in OPTIONAL_OPERATIONS and not include_writes:
+            raise SystemExit(f"{name} writes to flash, pass --include-writes to use it")
+        mix[name] = float(weight)
+    return mix
+
+
+def linear_slope(xs, ys):
+    """Least squares slope of ys over xs, None with fewer than two points."""
+    if len(xs) < 2:
+        return None
+    mean_x = sum(xs) / len(xs)
+    mean_y = sum(ys) / len(ys)
+    denominator = sum((x - mean_x) ** 2 for x in xs)
+    if denominator == 0:
+        return None
+    return sum((x - mean_x) * (y - mean_y) for x, y in zip(xs, ys)) / denominator
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Load and soak test for the train controller REST API")
+    parser.add_argument("--host", default="esp32-controller", help="Hostname or IP of the device")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--concurrency", type=int, default=4, help="Parallel client connections")
+    parser.add_argument("--duration", type=float, default=60, help="Run time in seconds")
+    parser.add_argument("--soak-hours", type=float, help="Run a soak test for this many hours instead")
+    parser.add_argument("--window", type=float, help="Reporting window in seconds (default: whole run, 300 in soak mode)")
+    parser.add_argument("--mix", help="Weighted operations, e.g. pinValuesGet=40,pinValuesPost=35,logGet=5")
+    parser.add_argument("--include-writes", action="store_true", help="Allow POST /network, which writes to flash")
+    parser.add_argument("--timeout", type=float, default=5.0, help="Per-request timeout in seconds")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--csv", help="Write one row per window to this file")
+    args = parser.parse_args()
+
+    base_url = f"http://{args.host}" if args.port == 80 else f"http://{args.host}:{args.port}"
+    duration = args.soak_hours * 3600 if args.soak_hours else args.duration
+    window = args.window or (300 if args.soak_hours else duration)
+    mix = parse_mix(args.mix, args.include_writes)
+
+    generator = LoadGenerator(base_url, mix, args.concurrency, args.timeout, args.seed)
+    total = Stats()
+    history = []  # (elapsed s, p50, p99, freeHeap, minFreeHeap)
+    started = time.monotonic()
+
+    csv_file = open(args.csv, "w", newline="") if args.csv else None
+    csv_writer = csv.writer(csv_file) if csv_file else None
+    if csv_writer:
+        csv_writer.writerow(["elapsedS", "requests", "throughput", "errorRate", "p50", "p99", "p999",
+                             "freeHeap", "minFreeHeap", "maxAllocHeap"])
+
+    def on_window(stats):
+        # Keep every latency for the final report
+        for label, values in stats.latencies.items():
+            for value in values:
+                total.record(label, value, None)
+        for label, counts in stats.errors.items():
+            for kind, count in counts.items():
+                with total.lock:
+                    total.errors.setdefault(label, {})
+                    total.errors[label][kind] = total.errors[label].get(kind, 0) + count
+
+        rows, errors = stats.summary()
+        status = get_status(base_url, args.timeout) or {}
+        elapsed = time.monotonic() - started
+        overall = rows["ALL"]
+        history.append((elapsed, overall["p50"], overall["p99"], status.get("freeHeap"), status.get("minFreeHeap")))
+
+        print_summary(f"[{elapsed:8.0f} s] freeHeap={status.get('freeHeap')} minFreeHeap={status.get('minFreeHeap')}",
+                      rows, errors)
+        if csv_writer:
+            csv_writer.writerow([round(elapsed), overall["requests"], round(overall["throughput"], 2),
+                                 round(overall["errorRate"], 5), round(overall["p50"], 2), round(overall["p99"], 2),
+                                 round(overall["p999"], 2), status.get("freeHeap"), status.get("minFreeHeap"),
+                                 status.get("maxAllocHeap")])
+            csv_file.flush()
+
+    try:
+        generator.run(duration, window, on_window)
+    except KeyboardInterrupt:
+        print("Interrupted, reporting what was collected")
+    finally:
+        if csv_file:
+            csv_file.close()
+
+    total.started = started
+    rows, errors = total.summary()
+    print()
+    print_summary(f"Total over {time.monotonic() - started:.0f} s at concurrency {args.concurrency}", rows, errors)
+
+    # Drift: compare the first and last window and fit a trend through the heap samples
+    if len(history) >= 2:
+        first, last = history[0], history[-1]
+        print()
+        print(f"Latency drift: p50 {first[1]:.1f} -> {last[1]:.1f} ms, p99 {first[2]:.1f} -> {last[2]:.1f} ms")
+        heap_points = [(t, heap) for t, _, _, heap, _ in history if heap is not None]
+        slope = linear_slope([t for t, _ in heap_points], [heap for _, heap in heap_points])
+        if slope is not None:
+            print(f"Free heap trend: {slope * 3600:+.0f} bytes/hour "
+                  f"({heap_points[0][1]} -> {heap_points[-1][1]} bytes)")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,87 @@
+"""Build a compressed OTA image for POST /update.
+
+Without --base the new firmware image is just gzipped. With --base (the image
+currently running on the device) a delta is written that copies unchanged
+ranges from the running partition, and the delta is gzipped as well.
+
+The SHA-256 of the resulting firmware image is printed; pass it to the device
+with the sha256 query parameter so the update is verified while it streams.
+The upload also needs the device's OTA_TOKEN in the X-OTA-Token header.
+
+Examples:
+    python MakeDelta.py build/trainController.ino.bin update.bin.gz
+    python MakeDelta.py build/new.bin update.delta.gz --base build/old.bin
+"""
+import argparse
+import gzip
+import hashlib
+import struct
+
+MAGIC = b"TCDELTA1"
+BLOCK = 16      # Bytes hashed to find candidate matches
+MIN_COPY = 24   # Shorter matches are cheaper as literals
+
+
+def make_delta(base, new):
+    index = {}
+    for offset in range(0, len(base) - BLOCK + 1):
+        index.setdefault(base[offset:offset + BLOCK], offset)
+
+    out = bytearray(MAGIC + struct.pack("<I", len(new)))
+    literal = bytearray()
+    copies = 0
+
+    def flush_literal():
+        if literal:
+            out.extend(b"I" + struct.pack("<I", len(literal)) + literal)
+            literal.clear()
+
+    pos = 0
+    while pos < len(new):
+        source = index.get(new[pos:pos + BLOCK]) if pos + BLOCK <= len(new) else None
+        length = 0
+        if source is not None:
+            while (pos + length < len(new) and source + length < len(base)
+                   and new[pos + length] == base[source + length]):
+                length += 1
+        if length >= MIN_COPY:
+            flush_literal()
+            out.extend(b"C" + struct.pack("<II", source, length))
+            copies += 1
+            pos += length
+        else:
+            literal.append(new[pos])
+            pos += 1
+
+    flush_literal()
+    out.extend(b"E")
+    return bytes(out), copies
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build a gzip or gzip+delta OTA image")
+    parser.add_argument("image", help="New firmware image (.bin)")
+    parser.add_argument("output", help="File to write")
+    parser.add_argument("--base", help="Image currently running on the device, enables delta mode")
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as f:
+        new = f.read()
+
+    payload = new
+    if args.base:
+        with open(args.base, "rb") as f:
+            base = f.read()
+        payload, copies = make_delta(base, new)
+        print(f"Delta: {len(payload)} bytes, {copies} copy ranges")
+
+    compressed = gzip.compress(payload, compresslevel=9)
+    with open(args.output, "wb") as f:
+        f.write(compressed)
+
+    print(f"Image: {len(new)} bytes, upload: {len(compressed)} bytes ({len(compressed) / max(len(new), 1):.1%})")
+    print(f"sha256={hashlib.sha256(new).hexdigest()}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,86 @@
+"""Round trip latency probe for the train controller.
+
+Sends GET /ping at a fixed interval over one keep-alive connection. Every ping
+carries the round trip measured for the previous one, so the device keeps its
+own rolling statistics for this client. At the end the percentiles measured
+here are printed next to the ones the device reports.
+
+With --profile the latency profile is changed first (and left that way), which
+makes it easy to compare e.g. powerSave=true against powerSave=false.
+
+Examples:
+    python PingTest.py --host esp32-controller --count 200 --interval 0.05
+    python PingTest.py --host 192.168.1.150 --profile powerSave=true,dtimPeriod=3
+"""
+import argparse
+import time
+
+import requests
+
+from EndPointFunctions import get_latency_profile, get_ping, post_latency_profile
+
+
+def percentile(sorted_values, fraction):
+    if not sorted_values:
+        return 0.0
+    return sorted_values[min(len(sorted_values) - 1, int(len(sorted_values) * fraction))]
+
+
+def parse_profile(text):
+    profile = {}
+    for item in text.split(","):
+        key, _, value = item.partition("=")
+        if value.lower() in ("true", "false"):
+            profile[key] = value.lower() == "true"
+        else:
+            profile[key] = int(value)
+    return profile
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Measure round trip latency with GET /ping")
+    parser.add_argument("--host", default="esp32-controller", help="Device hostname or IP")
+    parser.add_argument("--count", type=int, default=100, help="Number of pings")
+    parser.add_argument("--interval", type=float, default=0.1, help="Seconds between pings")
+    parser.add_argument("--id", default="pingtest", help="Client id the device keys its statistics on, at most 32 characters")
+    parser.add_argument("--profile", help="Latency profile to set first, e.g. powerSave=false,dtimPeriod=1")
+    args = parser.parse_args()
+
+    base_url = f"http://{args.host}"
+    if args.profile:
+        result = post_latency_profile(base_url, parse_profile(args.profile))
+        if result is None or "error" in result:
+            print(f"Could not set the latency profile: {result}")
+            return
+    print(f"Latency profile: {get_latency_profile(base_url)}")
+
+    session = requests.Session()
+    rtts = []
+    failures = 0
+    last_rtt = None
+    device = None
+    for _ in range(args.count):
+        start = time.perf_counter()
+        reply = get_ping(base_url, int(time.time() * 1000), last_rtt, args.id, session)
+        elapsed = (time.perf_counter() - start) * 1000
+        if reply is None:
+            failures += 1
+            last_rtt = None
+        else:
+            rtts.append(elapsed)
+            last_rtt = elapsed
+            device = reply
+        time.sleep(args.interval)
+
+    rtts.sort()
+    print(f"{len(rtts)} replies, {failures} failures")
+    if rtts:
+        print(f"client: min {rtts[0]:.1f} avg {sum(rtts) / len(rtts):.1f} p50 {percentile(rtts, 0.5):.1f} "
+              f"p95 {percentile(rtts, 0.95):.1f} p99 {percentile(rtts, 0.99):.1f} max {rtts[-1]:.1f} ms")
+    if device and device.get("samples"):
+        print(f"device: min {device['minMs']:.1f} avg {device['avgMs']:.1f} p50 {device['p50Ms']:.1f} "
+              f"p95 {device['p95Ms']:.1f} max {device['maxMs']:.1f} ms over the last {device['samples']} pings")
+
+
+if __name__ == "__main__":
+    main()
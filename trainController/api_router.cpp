@@ -0,0 +1,181 @@
+// api_router.cpp
+#include "api_router.h"
+#include "network_manager.h"
+
+
+namespace ApiRouter {
+
+    // Raw request body collected by onBody, freed by the request destructor
+    struct RawBody {
+        size_t length;
+        uint8_t data[];
+    };
+
+    struct FormatStats {
+        uint32_t requests = 0;  // Bodies parsed
+        uint32_t responses = 0;
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+        uint64_t parseUs = 0;
+        uint64_t serializeUs = 0;
+    };
+
+    // Only touched from the web server task
+    FormatStats stats[FORMAT_COUNT];
+
+    const char* const formatNames[FORMAT_COUNT] = {"json", "msgpack"};
+    const char* const mimeTypes[FORMAT_COUNT] = {"application/json", "application/msgpack"};
+
+
+    bool isMsgPack(const String& mimeType) {
+        return mimeType.indexOf("msgpack") >= 0; // application/msgpack, application/x-msgpack, application/vnd.msgpack
+    }
+
+
+    // MessagePack only when the client asks for it, anything else gets JSON
+    Format responseFormat(AsyncWebServerRequest* request) {
+        if (request->hasHeader("Accept") && isMsgPack(request->getHeader("Accept")->value())) {
+            return FORMAT_MSGPACK;
+        }
+        return FORMAT_JSON;
+    }
+
+
+    void collectBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+        if (index == 0) {
+            if (total > MAX_BODY_SIZE || request->_tempObject != nullptr) {
+                return;
+            }
+            RawBody* raw = static_cast<RawBody*>(malloc(sizeof(RawBody) + total));
+            if (raw == nullptr) {
+                return;
+            }
+            raw->length = total;
+            request->_tempObject = raw;
+        }
+        RawBody* raw = static_cast<RawBody*>(request->_tempObject);
+        if (raw != nullptr && index + len <= raw->length) {
+            memcpy(raw->data + index, data, len);
+        }
+    }
+
+
+    // Parse the form field "body" (JSON, what the GUIs send) or a raw JSON or MessagePack body
+    bool parseBody(Context& context) {
+        AsyncWebServerRequest* request = context.request;
+        Format format = FORMAT_JSON;
+        DeserializationError error;
+        size_t length = 0;
+        uint32_t start = micros();
+
+        if (request->hasParam("body", true)) {
+            const String& text = request->getParam("body", true)->value();
+            length = text.length();
+            error = deserializeJson(context.body, text);
+        } else if (request->contentType().indexOf("cbor") >= 0) {
+            context.response["error"] = "Unsupported Content-Type, use application/json or application/msgpack";
+            context.status = 415;
+            return false;
+        } else if (request->contentLength() > MAX_BODY_SIZE) {
+            context.response["error"] = "Body larger than " + String(MAX_BODY_SIZE) + " bytes";
+            context.status = 413;
+            return false;
+        } else if (request->_tempObject != nullptr) {
+            const RawBody* raw = static_cast<const RawBody*>(request->_tempObject);
+            const char* data = reinterpret_cast<const char*>(raw->data);
+            length = raw->length;
+            if (isMsgPack(request->contentType())) {
+                format = FORMAT_MSGPACK;
+                error = deserializeMsgPack(context.body, data, length);
+            } else {
+                error = deserializeJson(context.body, data, length);
+            }
+        } else {
+            context.response["error"] = "Invalid JSON";
+            context.status = 400;
+            return false;
+        }
+
+        stats[format].requests++;
+        stats[format].bytesIn += length;
+        stats[format].parseUs += micros() - start;
+
+        if (error) {
+            context.response["error"] = format == FORMAT_MSGPACK ? "Invalid MessagePack" : "Invalid JSON";
+            context.response["details"] = error.c_str();
+            context.status = 400;
+            return false;
+        }
+        return true;
+    }
+
+
+    void send(AsyncWebServerRequest* request, int status, Format format, const JsonDocument& response) {
+        // Small replies should leave in one segment instead of waiting for the client's ACK
+        if (NetworkManager2::latencyProfile.noDelay && request->client()) {
+            request->client()->setNoDelay(true);
+        }
+
+        AsyncResponseStream* stream = request->beginResponseStream(mimeTypes[format]);
+        stream->setCode(status);
+        uint32_t start = micros();
+        size_t length = format == FORMAT_MSGPACK ? serializeMsgPack(response, *stream) : serializeJson(response, *stream);
+        stats[format].serializeUs += micros() - start;
+        stats[format].responses++;
+        stats[format].bytesOut += length;
+        request->send(stream);
+    }
+
+
+    void handle(const Route& route, AsyncWebServerRequest* request) {
+        DynamicJsonDocument body(route.bodyCapacity);
+        DynamicJsonDocument response(route.responseSize != nullptr ? route.responseSize() : route.responseCapacity);
+        Context context = {request, body, response, 200};
+
+        if (route.bodyCapacity == 0 || parseBody(context)) {
+            route.handler(context);
+        }
+        // A truncated document would still serialize, as valid but incomplete data
+        if (response.overflowed()) {
+            response.clear();
+            response["error"] = "Response too large";
+            context.status = 500;
+        }
+        send(request, context.status, responseFormat(request), response);
+    }
+
+
+    void registerRoutes(AsyncWebServer& server, const Route* routes, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const Route* route = &routes[i];
+            ArUploadHandlerFunction onUpload = nullptr;
+            ArBodyHandlerFunction onBody = nullptr;
+            if (route->upload != nullptr) {
+                onUpload = route->upload;
+            }
+            if (route->bodyCapacity > 0) {
+                onBody = collectBody;
+            }
+
+            for (const String& uri : {String(route->path), String(API_PREFIX) + route->path}) {
+                server.on(uri.c_str(), route->method, [route](AsyncWebServerRequest* request) {
+                    handle(*route, request);
+                }, onUpload, onBody);
+            }
+        }
+    }
+
+
+    void describe(JsonObject target) {
+        for (size_t i = 0; i < FORMAT_COUNT; ++i) {
+            const FormatStats& format = stats[i];
+            JsonObject formatObj = target.createNestedObject(formatNames[i]);
+            formatObj["requests"] = format.requests;
+            formatObj["responses"] = format.responses;
+            formatObj["avgBytesIn"] = static_cast<uint32_t>(format.requests > 0 ? format.bytesIn / format.requests : 0);
+            formatObj["avgBytesOut"] = static_cast<uint32_t>(format.responses > 0 ? format.bytesOut / format.responses : 0);
+            formatObj["avgParseUs"] = static_cast<uint32_t>(format.requests > 0 ? format.parseUs / format.requests : 0);
+            formatObj["avgSerializeUs"] = static_cast<uint32_t>(format.responses > 0 ? format.serializeUs / format.responses : 0);
+        }
+    }
+}
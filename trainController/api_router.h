@@ -0,0 +1,51 @@
+// api_router.h
+#ifndef API_ROUTER_H
+#define API_ROUTER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+
+// One route table for all REST endpoints. Every route is served under its
+// original path and under /api/v2. Bodies and responses are JSON or MessagePack,
+// chosen by Content-Type and Accept; both carry the same document.
+namespace ApiRouter {
+    enum Format : uint8_t {
+        FORMAT_JSON,
+        FORMAT_MSGPACK,
+        FORMAT_COUNT
+    };
+
+    const char* const API_PREFIX = "/api/v2";
+    const size_t MAX_BODY_SIZE = 4096; // Raw (non-form) request bodies
+
+    struct Context {
+        AsyncWebServerRequest* request;
+        JsonDocument& body;     // Parsed request body, empty for routes without one
+        JsonDocument& response; // Filled by the handler, serialized in the negotiated format
+        int status;             // 200 unless the handler changes it
+    };
+
+    using Handler = void (*)(Context& context);
+    using CapacityFunction = size_t (*)();
+    using UploadHandler = void (*)(AsyncWebServerRequest* request, const String& filename, size_t index,
+                                   uint8_t* data, size_t len, bool final);
+
+    struct Route {
+        const char* path;
+        WebRequestMethodComposite method;
+        size_t bodyCapacity;     // 0 when the route takes no body
+        size_t responseCapacity;
+        Handler handler;
+        UploadHandler upload;    // Multipart uploads, nullptr for most routes
+        CapacityFunction responseSize; // Optional, sizes the response from the current state instead
+    };
+
+    // Routes sharing a prefix must be listed longest path first
+    void registerRoutes(AsyncWebServer& server, const Route* routes, size_t count);
+
+    // Per-format request counts, sizes and parse/serialize times, for /status
+    void describe(JsonObject target);
+}
+
+#endif
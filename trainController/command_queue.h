@@ -0,0 +1,108 @@
+// command_queue.h
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded multi-producer / single-consumer queue.
+// Every slot carries a sequence number, so producers only contend on a single
+// compare-and-swap of the write position and never block each other or the consumer.
+// Capacity must be a power of two. No dependency on Arduino, so it also builds on a host.
+template <typename T, size_t Capacity>
+class MpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MpscQueue() : enqueuePos(0), dequeuePos(0) {
+        for (size_t i = 0; i < Capacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // Safe to call from any task. Returns false when the queue is full.
+    bool tryPush(const T& item) {
+        Cell* cell;
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells[pos & (Capacity - 1)];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // Full
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = item;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Push all items or none, they take consecutive positions. Safe to call from any
+    // task. Returns false when fewer than count slots are free.
+    bool tryPushAll(const T* items, size_t count) {
+        if (count == 0) {
+            return true;
+        }
+        if (count > Capacity) {
+            return false;
+        }
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            // The consumer frees slots in order, so the range is free if its last slot is
+            size_t seq = cells[(pos + count - 1) & (Capacity - 1)].sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + count - 1);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // Not enough room
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            Cell& cell = cells[(pos + i) & (Capacity - 1)];
+            cell.data = items[i];
+            cell.sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        return true;
+    }
+
+    // Must only be called from the single consumer task. Returns false when empty.
+    bool tryPop(T& item) {
+        Cell& cell = cells[dequeuePos & (Capacity - 1)];
+        size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(dequeuePos + 1) < 0) {
+            return false; // Empty, or a producer has claimed the slot but not yet published it
+        }
+        item = cell.data;
+        cell.sequence.store(dequeuePos + Capacity, std::memory_order_release);
+        ++dequeuePos;
+        return true;
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    Cell cells[Capacity];
+    std::atomic<size_t> enqueuePos;
+    size_t dequeuePos; // Owned by the consumer
+};
+
+#endif
@@ -0,0 +1,132 @@
+// control_task.cpp
+#include "control_task.h"
+#include "command_queue.h"
+#include "log_manager.h"
+#include "throttle_manager.h"
+#include "servo_manager.h"
+#include "expander_manager.h"
+#include "rules_manager.h"
+
+
+namespace ControlTask {
+
+    MpscQueue<Command, COMMAND_QUEUE_SIZE> commandQueue;
+    TaskHandle_t taskHandle = nullptr;
+
+
+    uint32_t lastFrameMs = 0;
+    uint8_t frameCount = 0;
+    bool ledsPending = false; // Colors changed, or dithering needs the next frame
+
+
+    // Apply everything that is queued, returns true if LED colors changed
+    bool drainCommands() {
+        bool ledsDirty = false;
+        Command command;
+
+        while (commandQueue.tryPop(command)) {
+            switch (command.type) {
+                case SET_DIGITAL:
+                    PinManager::applyDigitalValue(command.pin, command.value);
+                    break;
+                case SET_PWM:
+                    PinManager::applyPwmValue(command.pin, command.value);
+                    break;
+                case SET_FASTLED:
+                    ledsDirty |= PinManager::applyFastLedColor(command.pin, CRGB(command.r, command.g, command.b));
+                    break;
+                case SET_SERVO:
+                    ServoManager::setTarget(command.pin, command.value);
+                    break;
+                case APPLY_DESIGNATION:
+                    PinManager::applyPinDesignation(*command.designation);
+                    delete command.designation;
+                    ledsDirty = true;
+                    break;
+                case APPLY_RULES:
+                    RulesManager::install(command.rules);
+                    break;
+            }
+        }
+
+        return ledsDirty;
+    }
+
+
+    void controlLoop(void* parameters) {
+        for (;;) {
+            // Woken by submit(), or once per tick for periodic work
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONTROL_TICK_MS));
+            ledsPending |= drainCommands();
+            ThrottleManager::poll();
+
+            // Sensor edges run their rules before the outputs are flushed
+            uint32_t now = millis();
+            ledsPending |= RulesManager::poll(now);
+            ServoManager::poll(now);
+
+            // Everything written to the expanders this tick, in one transaction per register block
+            ExpanderManager::flush();
+
+            // Changes made within one frame interval go out together in the next frame
+            if (ledsPending && now - lastFrameMs >= PinManager::ledFrameInterval()) {
+                lastFrameMs = now;
+                ledsPending = PinManager::renderLedFrame(frameCount++);
+            }
+        }
+    }
+
+
+    bool start() {
+        if (taskHandle != nullptr) {
+            return true;
+        }
+
+        BaseType_t result = xTaskCreatePinnedToCore(controlLoop, "control", 4096, nullptr, 2, &taskHandle, ARDUINO_RUNNING_CORE);
+        if (result != pdPASS) {
+            taskHandle = nullptr;
+            LOG_ERROR(CONTROL_TASK_FAILED);
+            return false;
+        }
+
+        LOG_INFO(CONTROL_TASK_STARTED);
+        return true;
+    }
+
+
+    // Safe to call from any task, never blocks
+    bool submit(const Command& command) {
+        if (!commandQueue.tryPush(command)) {
+            return false;
+        }
+        if (taskHandle != nullptr) {
+            xTaskNotifyGive(taskHandle);
+        }
+        return true;
+    }
+
+
+    // For requests that must not be applied in part
+    bool submitAll(const Command* commands, size_t count) {
+        if (!commandQueue.tryPushAll(commands, count)) {
+            return false;
+        }
+        if (taskHandle != nullptr) {
+            xTaskNotifyGive(taskHandle);
+        }
+        return true;
+    }
+
+
+    // Wake the control task from an interrupt, e.g. when an ADC frame is ready
+    void ARDUINO_ISR_ATTR notifyFromIsr() {
+        if (taskHandle == nullptr) {
+            return;
+        }
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(taskHandle, &higherPriorityTaskWoken);
+        if (higherPriorityTaskWoken) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
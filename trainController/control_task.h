@@ -0,0 +1,48 @@
+// control_task.h
+#ifndef CONTROL_TASK_H
+#define CONTROL_TASK_H
+
+#include <Arduino.h>
+#include "pin_manager.h"
+
+class RuleTable;
+
+namespace ControlTask {
+    // Commands that mutate pin state or hardware. Web handlers only validate and
+    // submit these, the control task is the single writer that applies them.
+    enum CommandType : uint8_t {
+        SET_DIGITAL,
+        SET_PWM,
+        SET_FASTLED,
+        SET_SERVO,
+        APPLY_DESIGNATION,
+        APPLY_RULES
+    };
+
+    struct Command {
+        CommandType type;
+        int pin;
+        int value;       // Digital level, PWM duty or servo position (0-100)
+        uint8_t r, g, b; // FastLED color
+        PinManager::PinDesignation* designation; // Owned by the queue until applied
+        RuleTable* rules;                        // Same
+    };
+
+    const size_t COMMAND_QUEUE_SIZE = 64;
+    const uint32_t CONTROL_TICK_MS = 10;
+    // LED frames go out only after a change or while dithering, at most every LED_FRAME_MS
+    // (100 FPS). show() blocks for the wire time, so longer strips get a longer interval that
+    // keeps it to 1/LED_SHOW_SHARE of the control task: 100 FPS up to about 150 LEDs, 16 FPS at 1,000.
+    // Temporal dithering needs at least 1000/LED_DITHER_MAX_MS FPS not to flicker, below that the
+    // per-LED offsets of a fixed frame dither in space only.
+    const uint32_t LED_FRAME_MS = 10;
+    const uint32_t LED_SHOW_SHARE = 2;
+    const uint32_t LED_DITHER_MAX_MS = 20;
+
+    bool start();
+    bool submit(const Command& command);
+    bool submitAll(const Command* commands, size_t count); // All or none
+    void notifyFromIsr();
+}
+
+#endif
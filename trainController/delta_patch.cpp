@@ -0,0 +1,156 @@
+// delta_patch.cpp
+#include "delta_patch.h"
+#include <cstring>
+
+
+namespace {
+    const char DELTA_MAGIC[] = "TCDELTA1";
+    const size_t HEADER_SIZE = 12;
+    const size_t COPY_CHUNK = 256;
+
+    uint32_t readU32(const uint8_t* p) {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    size_t opcodeSize(uint8_t opcode) {
+        switch (opcode) {
+            case 'C': return 9;
+            case 'I': return 5;
+            case 'E': return 1;
+            default:  return 0;
+        }
+    }
+}
+
+
+bool DeltaPatcher::isDelta(const uint8_t* data, size_t len) {
+    return len >= MAGIC_SIZE && memcmp(data, DELTA_MAGIC, MAGIC_SIZE) == 0;
+}
+
+
+DeltaPatcher::DeltaPatcher(SourceReader source, Sink sink)
+    : source(source), sink(sink), state(HEADER), errorMessage(nullptr), pendingLen(0),
+      insertRemaining(0), targetSize(0), outCount(0) {}
+
+
+DeltaPatcher::Status DeltaPatcher::write(const uint8_t* data, size_t len) {
+    size_t pos = 0;
+    while (pos < len && state != ERROR) {
+        switch (state) {
+            case HEADER:
+                pending[pendingLen++] = data[pos++];
+                if (pendingLen == HEADER_SIZE) {
+                    if (!isDelta(pending, pendingLen)) {
+                        fail("Not a delta image");
+                        break;
+                    }
+                    targetSize = readU32(pending + MAGIC_SIZE);
+                    pendingLen = 0;
+                    state = OPCODE;
+                }
+                break;
+
+            case OPCODE: {
+                pending[pendingLen++] = data[pos++];
+                size_t need = opcodeSize(pending[0]);
+                if (need == 0) {
+                    fail("Unknown delta opcode");
+                } else if (pendingLen == need) {
+                    pendingLen = 0;
+                    runOpcode();
+                }
+                break;
+            }
+
+            case INSERT: {
+                size_t chunk = len - pos;
+                if (chunk > insertRemaining) {
+                    chunk = insertRemaining;
+                }
+                if (emit(data + pos, chunk)) {
+                    pos += chunk;
+                    insertRemaining -= chunk;
+                    if (insertRemaining == 0) {
+                        state = OPCODE;
+                    }
+                }
+                break;
+            }
+
+            case FINISHED:
+                fail("Data after end of delta");
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if (state == ERROR) {
+        return FAILED;
+    }
+    return state == FINISHED ? DONE : NEED_INPUT;
+}
+
+
+bool DeltaPatcher::runOpcode() {
+    switch (pending[0]) {
+        case 'C':
+            return copyFromSource(readU32(pending + 1), readU32(pending + 5));
+        case 'I':
+            insertRemaining = readU32(pending + 1);
+            if (insertRemaining > 0) {
+                state = INSERT;
+            }
+            return true;
+        case 'E':
+            if (outCount != targetSize) {
+                fail("Delta output size mismatch");
+                return false;
+            }
+            state = FINISHED;
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+bool DeltaPatcher::copyFromSource(uint32_t offset, uint32_t len) {
+    uint8_t buffer[COPY_CHUNK];
+    while (len > 0) {
+        size_t chunk = len < COPY_CHUNK ? len : COPY_CHUNK;
+        if (!source(offset, buffer, chunk)) {
+            fail("Delta source read failed");
+            return false;
+        }
+        if (!emit(buffer, chunk)) {
+            return false;
+        }
+        offset += chunk;
+        len -= chunk;
+    }
+    return true;
+}
+
+
+bool DeltaPatcher::emit(const uint8_t* data, size_t len) {
+    if (len > targetSize - outCount) {
+        fail("Delta output exceeds target size");
+        return false;
+    }
+    if (!sink(data, len)) {
+        fail("Output sink rejected data");
+        return false;
+    }
+    outCount += len;
+    return true;
+}
+
+
+void DeltaPatcher::fail(const char* message) {
+    if (state != ERROR) {
+        errorMessage = message;
+        state = ERROR;
+    }
+}
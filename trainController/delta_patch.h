@@ -0,0 +1,53 @@
+// delta_patch.h
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Push-based applier for the delta format written by testTools/MakeDelta.py.
+// The new image is rebuilt from COPY ranges of the running image and INSERTed bytes:
+//   "TCDELTA1" u32 targetSize
+//   'C' u32 sourceOffset u32 length   copy from the running image
+//   'I' u32 length <bytes>            literal bytes
+//   'E'                               end, the output must be targetSize bytes
+// Integers are little endian. No Arduino dependency.
+class DeltaPatcher {
+public:
+    using SourceReader = std::function<bool(uint32_t offset, uint8_t* buffer, size_t len)>;
+    using Sink = std::function<bool(const uint8_t* data, size_t len)>;
+
+    enum Status { NEED_INPUT, DONE, FAILED };
+
+    static const size_t MAGIC_SIZE = 8;
+    static bool isDelta(const uint8_t* data, size_t len);
+
+    DeltaPatcher(SourceReader source, Sink sink);
+
+    Status write(const uint8_t* data, size_t len);
+
+    const char* error() const { return errorMessage; }
+    uint32_t totalOut() const { return outCount; }
+
+private:
+    enum State { HEADER, OPCODE, INSERT, FINISHED, ERROR };
+
+    SourceReader source;
+    Sink sink;
+    State state;
+    const char* errorMessage;
+
+    uint8_t pending[12]; // Header or opcode with its arguments
+    size_t pendingLen;
+    uint32_t insertRemaining;
+    uint32_t targetSize;
+    uint32_t outCount;
+
+    bool runOpcode();
+    bool copyFromSource(uint32_t offset, uint32_t len);
+    bool emit(const uint8_t* data, size_t len);
+    void fail(const char* message);
+};
+
+#endif
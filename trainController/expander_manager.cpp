@@ -0,0 +1,202 @@
+// expander_manager.cpp
+#include "expander_manager.h"
+#include "io_expander.h"
+#include "input_config.h"
+#include "log_manager.h"
+#include <Wire.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+
+namespace ExpanderManager {
+
+    struct Expander {
+        IoExpander* chip;
+        int firstPin;
+        bool failing; // Last flush failed, logged once per failure streak
+    };
+
+    std::vector<Expander> chips; // Fixed after begin()
+    std::mutex expanderMutex;   // Shadow registers are read from the web server task
+    std::vector<IoExpander::Batch> batches; // One per chip, flush() only
+
+
+    bool wireWrite(uint8_t address, const uint8_t* data, size_t len) {
+        Wire.beginTransmission(address);
+        Wire.write(data, len);
+        return Wire.endTransmission() == 0;
+    }
+
+
+    void begin() {
+        if (expanders.empty()) {
+            return;
+        }
+        if (!Wire.begin(i2cSdaPin, i2cSclPin, i2cFrequency)) {
+            LOG_ERROR(I2C_INIT_FAILED, i2cSdaPin, i2cSclPin);
+            return;
+        }
+        for (int pin : {i2cSdaPin, i2cSclPin}) {
+            if (std::find(reservedPins.begin(), reservedPins.end(), pin) == reservedPins.end()) {
+                reservedPins.push_back(pin);
+            }
+        }
+
+        for (const ExpanderConfig& config : expanders) {
+            IoExpander* chip = nullptr;
+            if (strcmp(config.type, "PCA9685") == 0) {
+                chip = new Pca9685(wireWrite, config.address, pca9685PwmHz);
+            } else if (strcmp(config.type, "MCP23017") == 0) {
+                chip = new Mcp23017(wireWrite, config.address);
+            } else {
+                LOG_ERROR(EXPANDER_UNKNOWN, config.type);
+                continue;
+            }
+
+            if (!chip->begin()) {
+                LOG_ERROR(EXPANDER_NOT_FOUND, config.type, static_cast<unsigned int>(config.address));
+                delete chip;
+                continue;
+            }
+            for (size_t channel = 0; channel < chip->channels(); ++channel) {
+                availablePins.push_back(config.firstPin + channel);
+            }
+            chips.push_back({chip, config.firstPin, false});
+            batches.emplace_back();
+            LOG_INFO(EXPANDER_STARTED, config.type, static_cast<unsigned int>(config.address), config.firstPin);
+        }
+    }
+
+
+    // The chip that owns a virtual pin, nullptr for native pins
+    const Expander* find(int pin, size_t& channel) {
+        for (const Expander& expander : chips) {
+            if (pin >= expander.firstPin && pin < expander.firstPin + (int)expander.chip->channels()) {
+                channel = pin - expander.firstPin;
+                return &expander;
+            }
+        }
+        return nullptr;
+    }
+
+
+    bool isVirtualPin(int pin) {
+        size_t channel;
+        return find(pin, channel) != nullptr;
+    }
+
+
+    bool supportsPwm(int pin) {
+        size_t channel;
+        const Expander* expander = find(pin, channel);
+        return expander != nullptr && expander->chip->supportsPwm();
+    }
+
+
+    void setOutput(int pin, bool output) {
+        size_t channel;
+        const Expander* expander = find(pin, channel);
+        if (expander != nullptr) {
+            std::lock_guard<std::mutex> lock(expanderMutex);
+            expander->chip->setOutput(channel, output);
+        }
+    }
+
+
+    void writeDigital(int pin, int level) {
+        size_t channel;
+        const Expander* expander = find(pin, channel);
+        if (expander != nullptr) {
+            std::lock_guard<std::mutex> lock(expanderMutex);
+            uint16_t high = expander->chip->supportsPwm() ? IoExpander::PWM_MAX : 1;
+            expander->chip->write(channel, level ? high : 0);
+        }
+    }
+
+
+    void writePwm(int pin, int percent) {
+        size_t channel;
+        const Expander* expander = find(pin, channel);
+        if (expander != nullptr) {
+            std::lock_guard<std::mutex> lock(expanderMutex);
+            expander->chip->write(channel, percent * IoExpander::PWM_MAX / 100);
+        }
+    }
+
+
+    // Send what changed since the last tick. The changed registers are copied under the
+    // lock and the bus transactions run without it, so readers never wait on I2C.
+    void flush() {
+        {
+            std::lock_guard<std::mutex> lock(expanderMutex);
+            for (size_t i = 0; i < chips.size(); ++i) {
+                chips[i].chip->capture(batches[i]);
+            }
+        }
+
+        bool anySent = false;
+        for (size_t i = 0; i < chips.size(); ++i) {
+            if (batches[i].count > 0) {
+                chips[i].chip->transmit(batches[i]);
+                anySent = true;
+            }
+        }
+        if (!anySent) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(expanderMutex);
+        for (size_t i = 0; i < chips.size(); ++i) {
+            Expander& expander = chips[i];
+            const IoExpander::Batch& batch = batches[i];
+            if (batch.count == 0) {
+                continue;
+            }
+            expander.chip->complete(batch);
+            bool ok = batch.sent == batch.count;
+            if (!ok && !expander.failing) {
+                LOG_WARN(EXPANDER_WRITE_FAILED, expander.chip->type(), static_cast<unsigned int>(expander.chip->busAddress()));
+            }
+            expander.failing = !ok;
+        }
+    }
+
+
+    int readDigital(int pin) {
+        size_t channel;
+        const Expander* expander = find(pin, channel);
+        if (expander == nullptr) {
+            return 0;
+        }
+        std::lock_guard<std::mutex> lock(expanderMutex);
+        return expander->chip->read(channel) != 0;
+    }
+
+
+    int readPwm(int pin) {
+        size_t channel;
+        const Expander* expander = find(pin, channel);
+        if (expander == nullptr) {
+            return 0;
+        }
+        std::lock_guard<std::mutex> lock(expanderMutex);
+        return expander->chip->read(channel) * 255 / IoExpander::PWM_MAX;
+    }
+
+
+    void describe(JsonArray& target) {
+        std::lock_guard<std::mutex> lock(expanderMutex);
+        for (const Expander& expander : chips) {
+            JsonObject obj = target.createNestedObject();
+            obj["type"] = expander.chip->type();
+            obj["address"] = expander.chip->busAddress();
+            obj["firstPin"] = expander.firstPin;
+            obj["pins"] = expander.chip->channels();
+            obj["transactions"] = expander.chip->transactions();
+            obj["bytes"] = expander.chip->bytesSent();
+            obj["skippedWrites"] = expander.chip->skippedWrites();
+            obj["online"] = !expander.failing;
+        }
+    }
+}
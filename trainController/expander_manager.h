@@ -0,0 +1,33 @@
+// expander_manager.h
+#ifndef EXPANDER_MANAGER_H
+#define EXPANDER_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// I2C expanders from input_config's expanders list, exposed as virtual pins
+// (firstPin + channel) that take the digital and PWM roles like native pins.
+// Writes update shadow registers, the control task flushes them once per tick,
+// so all changes of one tick go out in one transaction per chip and register block.
+namespace ExpanderManager {
+    // Setup only, called by initializePins before any pin is configured.
+    // Adds the pins of every chip that answered to availablePins.
+    void begin();
+
+    // Any task, the expander list does not change after begin()
+    bool isVirtualPin(int pin);
+    bool supportsPwm(int pin);
+
+    // Control task only
+    void setOutput(int pin, bool output);
+    void writeDigital(int pin, int level);
+    void writePwm(int pin, int percent);
+    void flush();
+
+    // Any task, values as last written
+    int readDigital(int pin);
+    int readPwm(int pin); // 0-255, like ledcRead on a native pin
+    void describe(JsonArray& target);
+}
+
+#endif
@@ -0,0 +1,482 @@
+// inflater.cpp
+#include "inflater.h"
+#include <cstring>
+
+
+namespace {
+    // Deflate base values and extra bits for length and distance codes
+    const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                      3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    const uint16_t DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                        8193, 12289, 16385, 24577};
+    const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    const uint8_t CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+    uint32_t crcTable[256];
+    bool crcTableReady = false;
+
+    void initCrcTable() {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            crcTable[n] = c;
+        }
+        crcTableReady = true;
+    }
+
+    uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t len) {
+        crc = ~crc;
+        while (len--) {
+            crc = crcTable[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+}
+
+
+Inflater::Inflater(Sink sink)
+    : sink(sink), state(GZIP_HEADER), errorMessage(nullptr), finalBlock(false), starved(false),
+      storedRemaining(0), inPos(0), bitBuf(0), bitCnt(0), window(new uint8_t[WINDOW_SIZE]),
+      windowPos(0), flushPos(0), outCount(0), crc(0) {
+    if (!crcTableReady) {
+        initCrcTable();
+    }
+}
+
+
+Inflater::~Inflater() {
+    delete[] window;
+}
+
+
+Inflater::Status Inflater::write(const uint8_t* data, size_t len) {
+    if (state == FINISHED) {
+        return len == 0 ? DONE : (fail("Data after end of gzip stream"), FAILED);
+    }
+    if (state == ERROR) {
+        return FAILED;
+    }
+
+    input.insert(input.end(), data, data + len);
+
+    // Every step either completes a unit of work or restores the input position and waits for more
+    bool progress = true;
+    while (progress && state != FINISHED && state != ERROR) {
+        switch (state) {
+            case GZIP_HEADER:  progress = parseGzipHeader(); break;
+            case BLOCK_HEADER: progress = parseBlockHeader(); break;
+            case STORED:       progress = copyStored(); break;
+            case CODES:        progress = decodeSymbol(); break;
+            case TRAILER:      progress = checkTrailer(); break;
+            default:           progress = false; break;
+        }
+    }
+
+    // Drop consumed input, keep the rest for the next chunk
+    input.erase(input.begin(), input.begin() + inPos);
+    inPos = 0;
+
+    if (state != ERROR && !flush()) {
+        fail("Output sink rejected data");
+    }
+    if (state == ERROR) {
+        return FAILED;
+    }
+    return state == FINISHED ? DONE : NEED_INPUT;
+}
+
+
+uint32_t Inflater::bits(int need) {
+    uint32_t value = bitBuf;
+    while (bitCnt < need) {
+        if (inPos >= input.size()) {
+            starved = true;
+            return 0;
+        }
+        value |= static_cast<uint32_t>(input[inPos++]) << bitCnt;
+        bitCnt += 8;
+    }
+    bitBuf = value >> need;
+    bitCnt -= need;
+    return value & ((1u << need) - 1);
+}
+
+
+int Inflater::readByte() {
+    if (inPos >= input.size()) {
+        starved = true;
+        return 0;
+    }
+    return input[inPos++];
+}
+
+
+// Canonical Huffman decode, one bit at a time
+int Inflater::decode(const Huffman& huffman) {
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len <= 15; ++len) {
+        code |= bits(1);
+        if (starved) {
+            return -1;
+        }
+        int count = huffman.count[len];
+        if (code - count < first) {
+            return huffman.symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -2; // Ran out of codes
+}
+
+
+// Returns 0 for a complete code, > 0 for an incomplete one, < 0 for an over-subscribed one
+int Inflater::build(Huffman& huffman, const uint8_t* lengths, int n) {
+    uint16_t offsets[16];
+    memset(huffman.count, 0, sizeof(huffman.count));
+    for (int symbol = 0; symbol < n; ++symbol) {
+        huffman.count[lengths[symbol]]++;
+    }
+    if (huffman.count[0] == n) {
+        return 0;
+    }
+
+    int left = 1;
+    for (int len = 1; len <= 15; ++len) {
+        left <<= 1;
+        left -= huffman.count[len];
+        if (left < 0) {
+            return left;
+        }
+    }
+
+    offsets[1] = 0;
+    for (int len = 1; len < 15; ++len) {
+        offsets[len + 1] = offsets[len] + huffman.count[len];
+    }
+    for (int symbol = 0; symbol < n; ++symbol) {
+        if (lengths[symbol] != 0) {
+            huffman.symbol[offsets[lengths[symbol]]++] = symbol;
+        }
+    }
+    return left;
+}
+
+
+bool Inflater::parseGzipHeader() {
+    Checkpoint start = checkpoint();
+    int id1 = readByte(), id2 = readByte(), method = readByte(), flags = readByte();
+    for (int i = 0; i < 6; ++i) {
+        readByte(); // MTIME, XFL, OS
+    }
+    if (!starved && (id1 != 0x1F || id2 != 0x8B || method != 8)) {
+        fail("Not a gzip stream");
+        return false;
+    }
+    if (flags & 0x04) { // FEXTRA
+        int extraLen = readByte();
+        extraLen |= readByte() << 8;
+        for (int i = 0; i < extraLen && !starved; ++i) {
+            readByte();
+        }
+    }
+    if (flags & 0x08) { // FNAME
+        while (!starved && readByte() != 0) {}
+    }
+    if (flags & 0x10) { // FCOMMENT
+        while (!starved && readByte() != 0) {}
+    }
+    if (flags & 0x02) { // FHCRC
+        readByte();
+        readByte();
+    }
+    if (starved) {
+        restore(start);
+        return false;
+    }
+    state = BLOCK_HEADER;
+    return true;
+}
+
+
+bool Inflater::parseBlockHeader() {
+    Checkpoint start = checkpoint();
+    finalBlock = bits(1) != 0;
+    uint32_t type = bits(2);
+    if (starved) {
+        restore(start);
+        return false;
+    }
+
+    switch (type) {
+        case 0: {
+            alignToByte();
+            int len = readByte();
+            len |= readByte() << 8;
+            int nlen = readByte();
+            nlen |= readByte() << 8;
+            if (starved) {
+                restore(start);
+                return false;
+            }
+            if (len != (~nlen & 0xFFFF)) {
+                fail("Stored block length mismatch");
+                return false;
+            }
+            storedRemaining = len;
+            state = STORED;
+            return true;
+        }
+        case 1:
+            buildFixedTables();
+            state = CODES;
+            return true;
+        case 2:
+            if (!parseDynamicTables()) {
+                if (starved) {
+                    restore(start);
+                }
+                return false;
+            }
+            state = CODES;
+            return true;
+        default:
+            fail("Invalid block type");
+            return false;
+    }
+}
+
+
+void Inflater::buildFixedTables() {
+    uint8_t lengths[288];
+    int symbol = 0;
+    for (; symbol < 144; ++symbol) lengths[symbol] = 8;
+    for (; symbol < 256; ++symbol) lengths[symbol] = 9;
+    for (; symbol < 280; ++symbol) lengths[symbol] = 7;
+    for (; symbol < 288; ++symbol) lengths[symbol] = 8;
+    build(lengthCodes, lengths, 288);
+
+    for (symbol = 0; symbol < 30; ++symbol) lengths[symbol] = 5;
+    build(distanceCodes, lengths, 30);
+}
+
+
+bool Inflater::parseDynamicTables() {
+    uint8_t lengths[320];
+    int nlen = bits(5) + 257;
+    int ndist = bits(5) + 1;
+    int ncode = bits(4) + 4;
+    if (starved) {
+        return false;
+    }
+    if (nlen > 286 || ndist > 30) {
+        fail("Bad dynamic block counts");
+        return false;
+    }
+
+    int index;
+    for (index = 0; index < ncode; ++index) {
+        lengths[CODE_LENGTH_ORDER[index]] = bits(3);
+    }
+    for (; index < 19; ++index) {
+        lengths[CODE_LENGTH_ORDER[index]] = 0;
+    }
+    if (starved) {
+        return false;
+    }
+    if (build(lengthCodes, lengths, 19) != 0) {
+        fail("Incomplete code length code");
+        return false;
+    }
+
+    index = 0;
+    while (index < nlen + ndist) {
+        int symbol = decode(lengthCodes);
+        if (starved) {
+            return false;
+        }
+        if (symbol < 0) {
+            fail("Bad code length code");
+            return false;
+        }
+        if (symbol < 16) {
+            lengths[index++] = symbol;
+            continue;
+        }
+
+        int len = 0, repeat;
+        if (symbol == 16) {
+            if (index == 0) {
+                fail("Repeat without previous length");
+                return false;
+            }
+            len = lengths[index - 1];
+            repeat = 3 + bits(2);
+        } else if (symbol == 17) {
+            repeat = 3 + bits(3);
+        } else {
+            repeat = 11 + bits(7);
+        }
+        if (starved) {
+            return false;
+        }
+        if (index + repeat > nlen + ndist) {
+            fail("Too many code lengths");
+            return false;
+        }
+        while (repeat--) {
+            lengths[index++] = len;
+        }
+    }
+
+    if (lengths[256] == 0) {
+        fail("Missing end of block code");
+        return false;
+    }
+    int err = build(lengthCodes, lengths, nlen);
+    if (err < 0 || (err > 0 && nlen - lengthCodes.count[0] != 1)) {
+        fail("Bad literal/length code");
+        return false;
+    }
+    err = build(distanceCodes, lengths + nlen, ndist);
+    if (err < 0 || (err > 0 && ndist - distanceCodes.count[0] != 1)) {
+        fail("Bad distance code");
+        return false;
+    }
+    return true;
+}
+
+
+// Decodes one literal, one end of block, or one complete length/distance pair
+bool Inflater::decodeSymbol() {
+    Checkpoint start = checkpoint();
+    int symbol = decode(lengthCodes);
+    if (starved) {
+        restore(start);
+        return false;
+    }
+    if (symbol < 0) {
+        fail("Bad literal/length symbol");
+        return false;
+    }
+
+    if (symbol < 256) {
+        put(symbol);
+        return true;
+    }
+    if (symbol == 256) {
+        state = finalBlock ? TRAILER : BLOCK_HEADER;
+        return true;
+    }
+
+    symbol -= 257;
+    if (symbol >= 29) {
+        fail("Bad length symbol");
+        return false;
+    }
+    size_t len = LENGTH_BASE[symbol] + bits(LENGTH_EXTRA[symbol]);
+    int distSymbol = decode(distanceCodes);
+    if (starved) {
+        restore(start);
+        return false;
+    }
+    if (distSymbol < 0 || distSymbol >= 30) {
+        fail("Bad distance symbol");
+        return false;
+    }
+    size_t dist = DISTANCE_BASE[distSymbol] + bits(DISTANCE_EXTRA[distSymbol]);
+    if (starved) {
+        restore(start);
+        return false;
+    }
+    if (dist > outCount || dist > WINDOW_SIZE) {
+        fail("Distance too far back");
+        return false;
+    }
+
+    while (len--) {
+        put(window[(windowPos - dist) & (WINDOW_SIZE - 1)]);
+    }
+    return true;
+}
+
+
+bool Inflater::copyStored() {
+    if (storedRemaining == 0) {
+        state = finalBlock ? TRAILER : BLOCK_HEADER;
+        return true;
+    }
+    if (inPos >= input.size()) {
+        return false;
+    }
+    while (storedRemaining > 0 && inPos < input.size()) {
+        put(input[inPos++]);
+        storedRemaining--;
+    }
+    return true;
+}
+
+
+bool Inflater::checkTrailer() {
+    Checkpoint start = checkpoint();
+    alignToByte();
+    uint32_t expectedCrc = 0, expectedSize = 0;
+    for (int i = 0; i < 4; ++i) expectedCrc |= static_cast<uint32_t>(readByte()) << (8 * i);
+    for (int i = 0; i < 4; ++i) expectedSize |= static_cast<uint32_t>(readByte()) << (8 * i);
+    if (starved) {
+        restore(start);
+        return false;
+    }
+
+    if (!flush()) {
+        fail("Output sink rejected data");
+        return false;
+    }
+    if (expectedCrc != crc || expectedSize != outCount) {
+        fail("gzip CRC or size mismatch");
+        return false;
+    }
+    state = FINISHED;
+    return true;
+}
+
+
+void Inflater::put(uint8_t byte) {
+    window[windowPos++] = byte;
+    outCount++;
+    if (windowPos == WINDOW_SIZE) {
+        if (!flush()) {
+            fail("Output sink rejected data");
+        }
+        windowPos = 0;
+        flushPos = 0;
+    }
+}
+
+
+bool Inflater::flush() {
+    if (windowPos == flushPos) {
+        return true;
+    }
+    const uint8_t* data = window + flushPos;
+    size_t len = windowPos - flushPos;
+    flushPos = windowPos;
+    crc = updateCrc(crc, data, len);
+    return sink(data, len);
+}
+
+
+void Inflater::fail(const char* message) {
+    if (state != ERROR) {
+        errorMessage = message;
+        state = ERROR;
+    }
+}
@@ -0,0 +1,90 @@
+// inflater.h
+#ifndef INFLATER_H
+#define INFLATER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Push-based gzip (RFC 1952 / deflate RFC 1951) decompressor.
+// Input can arrive in chunks of any size, output is handed to the sink in slices
+// of at most the 32 KB window. Memory use is the window plus the unconsumed input,
+// which never exceeds one chunk plus a dynamic block header. No Arduino dependency.
+class Inflater {
+public:
+    using Sink = std::function<bool(const uint8_t* data, size_t len)>;
+
+    enum Status { NEED_INPUT, DONE, FAILED };
+
+    explicit Inflater(Sink sink);
+    ~Inflater();
+
+    Inflater(const Inflater&) = delete;
+    Inflater& operator=(const Inflater&) = delete;
+
+    // Decompress as much of the input as possible. Returns DONE after the gzip trailer was verified.
+    Status write(const uint8_t* data, size_t len);
+
+    const char* error() const { return errorMessage; }
+    uint32_t totalOut() const { return outCount; }
+    static const size_t WINDOW_SIZE = 32768;
+
+private:
+    enum State { GZIP_HEADER, BLOCK_HEADER, STORED, CODES, TRAILER, FINISHED, ERROR };
+
+    struct Huffman {
+        uint16_t count[16];  // Number of codes of each length
+        uint16_t symbol[288]; // Symbols ordered by code
+    };
+
+    struct Checkpoint {
+        size_t inPos;
+        uint32_t bitBuf;
+        int bitCnt;
+    };
+
+    Sink sink;
+    State state;
+    const char* errorMessage;
+    bool finalBlock;
+    bool starved;
+    size_t storedRemaining;
+
+    std::vector<uint8_t> input; // Unconsumed input
+    size_t inPos;
+    uint32_t bitBuf;
+    int bitCnt;
+
+    uint8_t* window;
+    size_t windowPos;
+    size_t flushPos;
+    uint32_t outCount;
+    uint32_t crc;
+
+    Huffman lengthCodes;
+    Huffman distanceCodes;
+
+    Checkpoint checkpoint() const { return {inPos, bitBuf, bitCnt}; }
+    void restore(const Checkpoint& point) { inPos = point.inPos; bitBuf = point.bitBuf; bitCnt = point.bitCnt; starved = false; }
+
+    uint32_t bits(int need);
+    int readByte();
+    void alignToByte() { bitBuf = 0; bitCnt = 0; }
+    int decode(const Huffman& huffman);
+    static int build(Huffman& huffman, const uint8_t* lengths, int n);
+
+    bool parseGzipHeader();
+    bool parseBlockHeader();
+    bool parseDynamicTables();
+    void buildFixedTables();
+    bool decodeSymbol();
+    bool copyStored();
+    bool checkTrailer();
+
+    void put(uint8_t byte);
+    bool flush();
+    void fail(const char* message);
+};
+
+#endif
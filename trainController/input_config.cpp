@@ -5,6 +5,11 @@
 std::vector<int> pwmPins = {1, 2};
 std::vector<int> digitalPins = {3, 4};
 std::vector<int> fastLedPins = {5};
+std::vector<int> analogPins = {};
+std::vector<int> analogBindings = {};
+std::vector<int> adcPins = {0, 1, 2, 3, 4}; // ADC1, ADC2 is unusable while WiFi runs
+std::vector<int> servoPins = {};
+std::vector<int> sensorPins = {};
 std::vector<int> reservedPins = {7, 8, 9, 10, 20, 21};
 int statusLedPin = 7;
 std::vector<int> availablePins = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 20, 21};
@@ -12,10 +17,35 @@ std::vector<int> availablePins = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 20, 21};
 // FastLED configuration
 std::vector<int> numLeds = {60};
 std::vector<std::string> fastLedType = {"WS2812"};
+const int defaultNumLeds = 60;
+const int maxLedsPerStrip = 1024;
+const char* defaultFastLedType = "WS2812";
+const uint32_t ledPowerBudgetMa = 2000;
+const uint32_t ledMaPerChannel = 20;
+const uint32_t ledIdleMaPerLed = 1;
+const float ledGamma = 2.2f;
+
+// Servo configuration
+std::vector<ServoCalibration> servoCalibrations = {};
+const ServoCalibration defaultServoCalibration = {1000, 2000, 25}; // Full travel in 4 s
+
+// Sensor configuration
+const uint32_t sensorDebounceMs = 20;
+
+// I2C expanders, e.g. {{"PCA9685", 0x40, 100}, {"MCP23017", 0x20, 200}}
+std::vector<ExpanderConfig> expanders = {};
+const int i2cSdaPin = 6;
+const int i2cSclPin = 0;
+const uint32_t i2cFrequency = 400000;
+const uint16_t pca9685PwmHz = 1000;
 
 // Network
 int LISTEN_PORT = 80;
 int connectTimeout = 60;
 const char* apPassword = "Ditiseentest";
 const char* deviceID = "1234-5678-9012";
-const int AP_RETRY_INTERVAL = 30000; // 30 seconds
\ No newline at end of file
+const int AP_RETRY_INTERVAL = 30000; // 30 seconds
+const bool defaultWifiPowerSave = false;
+const bool defaultTcpNoDelay = true;
+const uint16_t defaultApBeaconIntervalTu = 100;
+const uint8_t defaultApDtimPeriod = 1;
\ No newline at end of file
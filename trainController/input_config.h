@@ -10,6 +10,11 @@
 extern std::vector<int> pwmPins; // Allows dynamic resizing and management of PWM pins.
 extern std::vector<int> digitalPins;
 extern std::vector<int> fastLedPins;
+extern std::vector<int> analogPins;     // Throttle knobs, sampled by the ADC
+extern std::vector<int> analogBindings; // PWM pin driven by each analog pin, -1 for none
+extern std::vector<int> adcPins;        // Pins that can be used as analog inputs
+extern std::vector<int> servoPins;      // Hobby servos for turnouts and signals, 50 Hz LEDC
+extern std::vector<int> sensorPins;     // Digital inputs (occupancy, reed switches) that trigger rules
 extern std::vector<int> reservedPins;
 extern int statusLedPin;
 extern std::vector<int> availablePins; // List of pins available
@@ -17,6 +22,37 @@ extern std::vector<int> availablePins; // List of pins available
 // FastLED configuration
 extern std::vector<int> numLeds;
 extern std::vector<std::string> fastLedType;
+extern const int defaultNumLeds; // Used for fastLed pins added without a count
+extern const int maxLedsPerStrip;
+extern const char* defaultFastLedType;
+extern const uint32_t ledPowerBudgetMa; // Shared 5 V supply budget for all strips
+extern const uint32_t ledMaPerChannel;  // Draw of one color channel at full duty
+extern const uint32_t ledIdleMaPerLed;
+extern const float ledGamma;
+
+// Servo configuration
+struct ServoCalibration {
+    int minUs; // Pulse width at position 0, 0 keeps the current calibration
+    int maxUs; // Pulse width at position 100
+    int speed; // Percent of the travel per second, 0 moves at once
+};
+extern std::vector<ServoCalibration> servoCalibrations; // Per servo pin
+extern const ServoCalibration defaultServoCalibration;
+
+// Sensor configuration
+extern const uint32_t sensorDebounceMs; // Changes within this time of the last edge are ignored
+
+// I2C expanders, their channels are virtual pins starting at firstPin
+struct ExpanderConfig {
+    const char* type; // "PCA9685" (PWM or digital) or "MCP23017" (digital)
+    uint8_t address;
+    int firstPin;
+};
+extern std::vector<ExpanderConfig> expanders;
+extern const int i2cSdaPin; // Reserved when expanders are configured
+extern const int i2cSclPin;
+extern const uint32_t i2cFrequency;
+extern const uint16_t pca9685PwmHz;
 
 // Network
 extern int LISTEN_PORT;
@@ -24,5 +60,9 @@ extern int connectTimeout; // Connection timeout in seconds
 extern const char* apPassword;
 extern const char* deviceID;
 extern const int AP_RETRY_INTERVAL;
+extern const bool defaultWifiPowerSave; // Latency profile defaults, see /latencyProfile
+extern const bool defaultTcpNoDelay;
+extern const uint16_t defaultApBeaconIntervalTu;
+extern const uint8_t defaultApDtimPeriod;
 
 #endif // INPUT_CONFIG_H
\ No newline at end of file
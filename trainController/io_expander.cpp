@@ -0,0 +1,230 @@
+// io_expander.cpp
+#include "io_expander.h"
+
+
+bool IoExpander::send(const uint8_t* data, size_t len) {
+    transactionCount++;
+    byteCount += len;
+    return bus(address, data, len);
+}
+
+
+bool IoExpander::flush() {
+    Batch batch;
+    capture(batch);
+    bool ok = transmit(batch);
+    complete(batch);
+    return ok;
+}
+
+
+bool IoExpander::transmit(Batch& batch) {
+    batch.sent = 0;
+    while (batch.sent < batch.count) {
+        const Batch::Transaction& transaction = batch.transactions[batch.sent];
+        if (!send(transaction.data, transaction.len)) {
+            return false;
+        }
+        batch.sent++;
+    }
+    return true;
+}
+
+
+namespace {
+    // PCA9685 registers
+    const uint8_t PCA_MODE1 = 0x00;
+    const uint8_t PCA_MODE2 = 0x01;
+    const uint8_t PCA_LED0_ON_L = 0x06;
+    const uint8_t PCA_ALL_LED_ON_L = 0xFA;
+    const uint8_t PCA_PRE_SCALE = 0xFE;
+    const uint8_t PCA_MODE1_AI = 0x20;    // Register auto-increment
+    const uint8_t PCA_MODE1_SLEEP = 0x10; // Oscillator off, needed to change the prescaler
+    const uint8_t PCA_MODE2_OUTDRV = 0x04; // Totem pole outputs
+    const uint8_t PCA_FULL = 0x10;        // Full on / full off bit in the _H registers
+    const uint32_t PCA_OSCILLATOR_HZ = 25000000;
+
+    // MCP23017 registers, IOCON.BANK = 0 so the A and B registers of a pair are adjacent
+    const uint8_t MCP_IODIRA = 0x00;
+    const uint8_t MCP_IOCON = 0x0A;
+    const uint8_t MCP_OLATA = 0x14;
+}
+
+
+Pca9685::Pca9685(BusWrite bus, uint8_t address, uint16_t pwmHz) : IoExpander(bus, address), pwmHz(pwmHz) {}
+
+
+bool Pca9685::begin() {
+    uint32_t prescale = (PCA_OSCILLATOR_HZ + 2048 * pwmHz) / (4096 * pwmHz); // Rounded
+    prescale = prescale < 4 ? 3 : (prescale > 256 ? 255 : prescale - 1);
+
+    const uint8_t sleep[] = {PCA_MODE1, PCA_MODE1_SLEEP | PCA_MODE1_AI};
+    const uint8_t frequency[] = {PCA_PRE_SCALE, static_cast<uint8_t>(prescale)};
+    const uint8_t mode2[] = {PCA_MODE2, PCA_MODE2_OUTDRV};
+    const uint8_t allOff[] = {PCA_ALL_LED_ON_L, 0x00, 0x00, 0x00, PCA_FULL};
+    const uint8_t wake[] = {PCA_MODE1, PCA_MODE1_AI};
+    if (!send(sleep, sizeof(sleep)) || !send(frequency, sizeof(frequency)) || !send(mode2, sizeof(mode2)) ||
+        !send(allOff, sizeof(allOff)) || !send(wake, sizeof(wake))) {
+        return false;
+    }
+
+    for (size_t i = 0; i < CHANNELS; ++i) {
+        pending[i] = 0;
+        written[i] = 0;
+    }
+    return true;
+}
+
+
+void Pca9685::write(size_t channel, uint16_t value) {
+    if (channel >= CHANNELS) {
+        return;
+    }
+    value = value > PWM_MAX ? PWM_MAX : value;
+    if (pending[channel] == value) {
+        skippedCount++;
+        return;
+    }
+    pending[channel] = value;
+}
+
+
+uint16_t Pca9685::read(size_t channel) const {
+    return channel < CHANNELS ? pending[channel] : 0;
+}
+
+
+void Pca9685::capture(Batch& batch) const {
+    batch.count = 0;
+    batch.sent = 0;
+    size_t first = CHANNELS, last = 0;
+    for (size_t i = 0; i < CHANNELS; ++i) {
+        batch.values[i] = pending[i];
+        if (pending[i] != written[i]) {
+            first = i < first ? i : first;
+            last = i;
+        }
+    }
+    if (first == CHANNELS) {
+        return;
+    }
+
+    // ON_L, ON_H, OFF_L, OFF_H per channel. 0 and PWM_MAX use the full off / full on bits.
+    Batch::Transaction& transaction = append(batch);
+    uint8_t* buffer = transaction.data;
+    size_t len = 0;
+    buffer[len++] = PCA_LED0_ON_L + 4 * first;
+    for (size_t i = first; i <= last; ++i) {
+        uint16_t value = pending[i];
+        buffer[len++] = 0x00;
+        buffer[len++] = value >= PWM_MAX ? PCA_FULL : 0x00;
+        buffer[len++] = value >= PWM_MAX ? 0x00 : value & 0xFF;
+        buffer[len++] = value == 0 ? PCA_FULL : (value >= PWM_MAX ? 0x00 : value >> 8);
+    }
+    transaction.len = len;
+}
+
+
+// Channels outside the sent range were captured equal to written, so copying all is exact
+void Pca9685::complete(const Batch& batch) {
+    if (batch.count == 0 || batch.sent < batch.count) {
+        return;
+    }
+    for (size_t i = 0; i < CHANNELS; ++i) {
+        written[i] = batch.values[i];
+    }
+}
+
+
+bool Mcp23017::begin() {
+    const uint8_t config[] = {MCP_IOCON, 0x00}; // BANK 0, sequential addressing
+    const uint8_t latches[] = {MCP_OLATA, 0x00, 0x00};
+    const uint8_t directions[] = {MCP_IODIRA, 0xFF, 0xFF};
+    if (!send(config, sizeof(config)) || !send(latches, sizeof(latches)) || !send(directions, sizeof(directions))) {
+        return false;
+    }
+
+    latchPending = latchWritten = 0;
+    directionPending = directionWritten = 0xFFFF;
+    return true;
+}
+
+
+void Mcp23017::setOutput(size_t channel, bool output) {
+    if (channel >= CHANNELS) {
+        return;
+    }
+    uint16_t bit = 1u << channel;
+    directionPending = output ? directionPending & ~bit : directionPending | bit;
+}
+
+
+void Mcp23017::write(size_t channel, uint16_t value) {
+    if (channel >= CHANNELS) {
+        return;
+    }
+    uint16_t bit = 1u << channel;
+    uint16_t updated = value != 0 ? latchPending | bit : latchPending & ~bit;
+    if (updated == latchPending) {
+        skippedCount++;
+        return;
+    }
+    latchPending = updated;
+}
+
+
+uint16_t Mcp23017::read(size_t channel) const {
+    return channel < CHANNELS ? (latchPending >> channel) & 1 : 0;
+}
+
+
+// Write one register pair, or just the half that changed
+void Mcp23017::capturePair(Batch& batch, uint8_t registerA, uint16_t pending, uint16_t written) {
+    uint16_t changed = pending ^ written;
+    if (changed == 0) {
+        return;
+    }
+
+    Batch::Transaction& transaction = append(batch);
+    uint8_t* buffer = transaction.data;
+    size_t len = 0;
+    if ((changed & 0x00FF) && (changed & 0xFF00)) {
+        buffer[len++] = registerA;
+        buffer[len++] = pending & 0xFF;
+        buffer[len++] = pending >> 8;
+    } else if (changed & 0x00FF) {
+        buffer[len++] = registerA;
+        buffer[len++] = pending & 0xFF;
+    } else {
+        buffer[len++] = registerA + 1;
+        buffer[len++] = pending >> 8;
+    }
+    transaction.len = len;
+}
+
+
+void Mcp23017::capture(Batch& batch) const {
+    batch.count = 0;
+    batch.sent = 0;
+    batch.values[0] = latchPending;
+    batch.values[1] = directionPending;
+    // Latches first, so a pin that becomes an output starts at its new level
+    capturePair(batch, MCP_OLATA, latchPending, latchWritten);
+    capturePair(batch, MCP_IODIRA, directionPending, directionWritten);
+}
+
+
+// The transactions are in capture order, a pair without one was unchanged
+void Mcp23017::complete(const Batch& batch) {
+    size_t index = 0;
+    if (batch.values[0] != latchWritten) {
+        if (index++ < batch.sent) {
+            latchWritten = batch.values[0];
+        }
+    }
+    if (batch.values[1] != directionWritten) {
+        if (index++ < batch.sent) {
+            directionWritten = batch.values[1];
+        }
+    }
+}
@@ -0,0 +1,138 @@
+// io_expander.h
+#ifndef IO_EXPANDER_H
+#define IO_EXPANDER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Output expanders on a register bus (I2C). Writes only update a shadow of the
+// output registers. flush() sends whatever differs from what the chip holds, in as
+// few bus transactions as the register layout allows, using register auto-increment.
+// The bus is a callback so the chips can be driven without Arduino. No Arduino dependency.
+//
+// A flush can also run in three steps, so a caller that guards the shadows with a lock
+// keeps the bus outside it: capture() copies the changed registers into a Batch (locked),
+// transmit() sends it (unlocked), complete() records what the chip now holds (locked).
+class IoExpander {
+public:
+    using BusWrite = std::function<bool(uint8_t address, const uint8_t* data, size_t len)>;
+
+    struct Batch {
+        static const size_t MAX_TRANSACTIONS = 2;
+        static const size_t MAX_BYTES = 1 + 4 * 16; // Register address and every PCA9685 channel
+
+        struct Transaction {
+            uint8_t data[MAX_BYTES];
+            size_t len;
+        };
+
+        Transaction transactions[MAX_TRANSACTIONS];
+        size_t count = 0;     // Transactions captured
+        size_t sent = 0;      // Transactions the bus took, in order
+        uint16_t values[16];  // Shadow registers as captured, layout is up to the chip
+    };
+
+    IoExpander(BusWrite bus, uint8_t address) : bus(bus), address(address) {}
+    virtual ~IoExpander() {}
+
+    IoExpander(const IoExpander&) = delete;
+    IoExpander& operator=(const IoExpander&) = delete;
+
+    virtual const char* type() const = 0;
+    virtual size_t channels() const = 0;
+    virtual bool supportsPwm() const = 0;
+
+    // Put the chip in a known state with all outputs off
+    virtual bool begin() = 0;
+
+    // Values are 0/1 for digital use, or 0 to PWM_MAX
+    virtual void setOutput(size_t channel, bool output) = 0;
+    virtual void write(size_t channel, uint16_t value) = 0;
+    virtual uint16_t read(size_t channel) const = 0;
+
+    // Send the pending changes, false if a bus write failed (it is retried next flush)
+    bool flush();
+
+    virtual void capture(Batch& batch) const = 0;
+    bool transmit(Batch& batch); // Stops at the first failed transaction, touches no shadow register
+    virtual void complete(const Batch& batch) = 0;
+
+    uint8_t busAddress() const { return address; }
+    uint32_t transactions() const { return transactionCount; }
+    uint32_t bytesSent() const { return byteCount; }
+    uint32_t skippedWrites() const { return skippedCount; } // Writes of a value already pending
+
+    static const uint16_t PWM_MAX = 4095;
+
+protected:
+    bool send(const uint8_t* data, size_t len);
+    static Batch::Transaction& append(Batch& batch) { return batch.transactions[batch.count++]; }
+
+    uint32_t skippedCount = 0;
+
+private:
+    BusWrite bus;
+    uint8_t address;
+    std::atomic<uint32_t> transactionCount{0}; // Counted by transmit, outside the caller's lock
+    std::atomic<uint32_t> byteCount{0};
+};
+
+
+// NXP PCA9685, 16 channels of 12-bit PWM. A flush writes every channel between the
+// first and the last changed one in a single transaction.
+class Pca9685 : public IoExpander {
+public:
+    Pca9685(BusWrite bus, uint8_t address, uint16_t pwmHz);
+
+    const char* type() const override { return "PCA9685"; }
+    size_t channels() const override { return CHANNELS; }
+    bool supportsPwm() const override { return true; }
+
+    bool begin() override;
+    void setOutput(size_t, bool) override {} // Always outputs
+    void write(size_t channel, uint16_t value) override;
+    uint16_t read(size_t channel) const override;
+    void capture(Batch& batch) const override;
+    void complete(const Batch& batch) override;
+
+    static const size_t CHANNELS = 16;
+
+private:
+    uint16_t pwmHz;
+    uint16_t pending[CHANNELS] = {};
+    uint16_t written[CHANNELS] = {};
+};
+
+
+// Microchip MCP23017, 16 digital pins on two 8-bit ports. A flush writes the output
+// latches, then the direction registers, one transaction each and only if changed.
+// The directions are not sent when the latches failed, so no pin drives a stale level.
+class Mcp23017 : public IoExpander {
+public:
+    Mcp23017(BusWrite bus, uint8_t address) : IoExpander(bus, address) {}
+
+    const char* type() const override { return "MCP23017"; }
+    size_t channels() const override { return CHANNELS; }
+    bool supportsPwm() const override { return false; }
+
+    bool begin() override;
+    void setOutput(size_t channel, bool output) override;
+    void write(size_t channel, uint16_t value) override;
+    uint16_t read(size_t channel) const override;
+    void capture(Batch& batch) const override;
+    void complete(const Batch& batch) override;
+
+    static const size_t CHANNELS = 16;
+
+private:
+    static void capturePair(Batch& batch, uint8_t registerA, uint16_t pending, uint16_t written);
+
+    uint16_t latchPending = 0;
+    uint16_t latchWritten = 0;
+    uint16_t directionPending = 0xFFFF; // 1 is input, the power-on state
+    uint16_t directionWritten = 0xFFFF;
+};
+
+#endif
@@ -0,0 +1,71 @@
+// led_pipeline.cpp
+#include "led_pipeline.h"
+#include <cmath>
+
+
+namespace LedPipeline {
+
+    // Gamma corrected output in 8.8 fixed point, the fraction is realized by dithering
+    uint16_t gammaTable[256];
+
+    // Bit reversed thresholds, so the on-frames of a fraction are spread over the cycle
+    const uint8_t DITHER_THRESHOLDS[8] = {0, 128, 64, 192, 32, 160, 96, 224};
+
+
+    void init(float gamma) {
+        for (int i = 0; i < 256; ++i) {
+            float value = std::pow(i / 255.0f, gamma) * GAMMA_MAX;
+            gammaTable[i] = static_cast<uint16_t>(value + 0.5f);
+        }
+    }
+
+
+    uint32_t gammaSum(const uint8_t* rgb, size_t channels) {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < channels; ++i) {
+            sum += gammaTable[rgb[i]];
+        }
+        return sum;
+    }
+
+
+    FrameStats budgetScale(uint64_t gammaTotal, size_t ledCount, const PowerBudget& budget) {
+        FrameStats stats;
+        uint64_t idleMa = static_cast<uint64_t>(ledCount) * budget.idleMaPerLed;
+        uint64_t driveMa = gammaTotal * budget.maPerChannel / GAMMA_MAX;
+        stats.requestedMa = static_cast<uint32_t>(idleMa + driveMa);
+
+        if (stats.requestedMa <= budget.budgetMa || driveMa == 0) {
+            stats.scaleQ16 = SCALE_ONE;
+        } else if (idleMa >= budget.budgetMa) {
+            stats.scaleQ16 = 0;
+        } else {
+            // Scale the driven part so idle + scaled drive fits the budget
+            uint64_t available = budget.budgetMa - idleMa;
+            stats.scaleQ16 = static_cast<uint32_t>(available * GAMMA_MAX * SCALE_ONE /
+                                                   (gammaTotal * budget.maPerChannel));
+        }
+        return stats;
+    }
+
+
+    bool renderStrip(const uint8_t* in, uint8_t* out, size_t channels, uint32_t scaleQ16, uint8_t frame) {
+        uint32_t fractions = 0;
+        for (size_t i = 0; i < channels; ++i) {
+            uint32_t scaled = (gammaTable[in[i]] * scaleQ16) >> 16;
+            // Offset the cycle per LED so neighbouring LEDs don't pulse in step
+            uint32_t threshold = DITHER_THRESHOLDS[(frame + i / 3) & 7];
+            out[i] = static_cast<uint8_t>((scaled + threshold) >> 8);
+            fractions |= scaled;
+        }
+        // A fraction below the smallest non-zero threshold (32) rounds the same way in every frame
+        return (fractions & 0xE0) != 0;
+    }
+
+
+    uint32_t frameIntervalMs(size_t ledCount, uint32_t minMs, uint32_t share) {
+        uint64_t showUs = static_cast<uint64_t>(ledCount) * WIRE_US_PER_LED + LATCH_US;
+        uint64_t intervalMs = (showUs * share + 999) / 1000;
+        return intervalMs > minMs ? static_cast<uint32_t>(intervalMs) : minMs;
+    }
+}
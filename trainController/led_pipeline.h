@@ -0,0 +1,47 @@
+// led_pipeline.h
+#ifndef LED_PIPELINE_H
+#define LED_PIPELINE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Per-frame LED output stage: gamma correction, a shared power budget and
+// temporal dithering. Works on packed 8-bit RGB bytes (the CRGB layout) with
+// table lookups and integer math only. No Arduino dependency.
+namespace LedPipeline {
+    struct PowerBudget {
+        uint32_t budgetMa;     // What the supply can deliver to all strips together
+        uint32_t maPerChannel; // Current of one color channel at full duty
+        uint32_t idleMaPerLed; // Quiescent current of one LED, drawn even when black
+    };
+
+    struct FrameStats {
+        uint32_t requestedMa; // Estimated draw of the unlimited frame
+        uint32_t scaleQ16;    // Brightness scale applied, 65536 is unlimited
+    };
+
+    const uint32_t SCALE_ONE = 65536;
+    const uint32_t GAMMA_MAX = 255 << 8; // Largest gamma table entry
+
+    // WS2812 wire time: 24 bits at 800 kHz per LED, then the latch gap. FastLED.show()
+    // blocks for about this long, 30 ms for 1,000 LEDs.
+    const uint32_t WIRE_US_PER_LED = 30;
+    const uint32_t LATCH_US = 300;
+
+    void init(float gamma);
+
+    // Sum of gamma corrected channel values (8.8 fixed point) of one strip
+    uint32_t gammaSum(const uint8_t* rgb, size_t channels);
+
+    // Scale that keeps all strips within the budget, from the summed gammaSum of every strip
+    FrameStats budgetScale(uint64_t gammaTotal, size_t ledCount, const PowerBudget& budget);
+
+    // Gamma, scale and dither one strip from its logical colors into its output buffer.
+    // Returns true if the output changes with the frame, i.e. dithering needs more frames.
+    bool renderStrip(const uint8_t* in, uint8_t* out, size_t channels, uint32_t scaleQ16, uint8_t frame);
+
+    // Shortest frame interval for ledCount LEDs, at least minMs, that keeps show() to 1/share of the time
+    uint32_t frameIntervalMs(size_t ledCount, uint32_t minMs, uint32_t share);
+}
+
+#endif
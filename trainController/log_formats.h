@@ -0,0 +1,93 @@
+// log_formats.h
+#ifndef LOG_FORMATS_H
+#define LOG_FORMATS_H
+
+#include <stdint.h>
+
+// Every log message has an id here. Records only store the id and the raw
+// arguments, the string is formatted when /log or the serial drain reads it.
+// Specifiers: %d int, %u unsigned, %s string (stored inline, see LOG_TEXT_SIZE), %I IPv4 address.
+#define LOG_FORMAT_LIST(X) \
+    X(BOOT, "Boot, reset reason %d") \
+    X(PREVIOUS_BOOT_RECORDS, "Recovered %u log records from previous boot") \
+    X(WIFI_INITIALIZING, "Initializing WiFi...") \
+    X(AP_MODE_STARTING, "Starting AP mode...") \
+    X(WIFI_INITIALIZED, "Done Initializing WiFi...") \
+    X(SERVER_SETUP, "Setting up server...") \
+    X(SERVER_STARTING, "Starting server...") \
+    X(SERVER_STARTED, "Server started...") \
+    X(BLINKING_OFF, "isBlinking set to false") \
+    X(BLINKING_ON, "isBlinking set to true") \
+    X(WIFI_RETRY, "Retrying WiFi connection...") \
+    X(STORED_NETWORKS_RETRY, "Retrying stored networks...") \
+    X(CONTROL_TASK_FAILED, "Failed to start control task.") \
+    X(CONTROL_TASK_STARTED, "Control task started.") \
+    X(AP_STOPPED, "Stopped AP mode.") \
+    X(WIFI_CONNECTED, "Connected to WiFi: %I") \
+    X(WIFI_CONNECT_FAILED, "Failed to connect to: %s") \
+    X(LITTLEFS_INIT_FAILED, "Failed to initialize LittleFS.") \
+    X(NO_SAVED_NETWORKS, "No saved networks found.") \
+    X(NETWORKS_FILE_EMPTY, "Empty networks file.") \
+    X(NETWORKS_FILE_PARSE_FAILED, "Failed to parse networks file.") \
+    X(NETWORKS_LOADED, "Loaded networks from storage.") \
+    X(NETWORKS_FILE_OPEN_FAILED, "Failed to open networks file for writing.") \
+    X(NETWORKS_SAVED, "Saved networks to storage.") \
+    X(LITTLEFS_MOUNT_FAILED, "Failed to mount LittleFS") \
+    X(NO_NETWORKS_LOADED, "No networks loaded from storage") \
+    X(NO_NETWORKS_AP_MODE, "No saved networks, starting AP mode") \
+    X(MDNS_STARTED, "mDNS responder started. Hostname: %s.local") \
+    X(MDNS_FAILED, "Error starting mDNS responder!") \
+    X(WIFI_CONNECTING, "Attempting to connect to WiFi: %s") \
+    X(WIFI_FAILED_AP_MODE, "Failed to connect, starting AP mode") \
+    X(MDNS_AP_STARTED, "mDNS responder started in AP mode. Hostname: %s.local") \
+    X(MDNS_AP_FAILED, "Error starting mDNS responder in AP mode!") \
+    X(AP_STARTED, "AP Mode started. SSID: %s") \
+    X(RECONNECTING, "Attempting to reconnect to stored networks...") \
+    X(NO_STORED_NETWORKS, "No stored networks to retry.") \
+    X(TRYING_DEFAULT_NETWORK, "Trying default network: %s") \
+    X(TRYING_ALL_NETWORKS, "No default network, trying all stored networks...") \
+    X(TRYING_NETWORK, "Trying network: %s") \
+    X(RECONNECTED, "Successfully reconnected to: %I") \
+    X(RECONNECT_FAILED, "Failed to reconnect, remaining in AP mode.") \
+    X(PINS_INITIALIZING, "Initializing pins.") \
+    X(PINS_INITIALIZED, "Pins initialized.") \
+    X(FASTLED_CLEANED_UP, "FastLED memory cleaned up.") \
+    X(FASTLED_PIN_UNSUPPORTED, "No FastLED controller for pin %d") \
+    X(PINS_RESET, "Pins reset.") \
+    X(PIN_DESIGNATION_STARTED, "postPinDesignation started.") \
+    X(PIN_DESIGNATION_QUEUED, "Pin designation update queued.") \
+    X(PIN_DESIGNATION_UPDATED, "Pin designation updated: %u attached, %u detached, %u resized.") \
+    X(PIN_VALUES_STARTED, "postPinValues started") \
+    X(PIN_VALUES_UPDATED, "Pin values updated") \
+    X(OTA_STARTED, "OTA update started") \
+    X(OTA_FAILED, "OTA update failed: %s") \
+    X(OTA_FINISHED, "OTA image written: %u bytes in %u ms, peak RAM %u bytes") \
+    X(OTA_PENDING_VERIFY, "Running a new image, confirming after %u ms") \
+    X(OTA_CONFIRMED, "New image confirmed, rollback cancelled") \
+    X(OTA_ROLLBACK, "Rolling back to the previous image") \
+    X(ADC_STARTED, "Continuous ADC sampling started on %u pins") \
+    X(ADC_FAILED, "Failed to start continuous ADC sampling") \
+    X(LATENCY_PROFILE_APPLIED, "Latency profile: power save %s, beacon %u TU, DTIM %u") \
+    X(SERVOS_CONFIGURED, "%u servos configured") \
+    X(SERVO_ATTACH_FAILED, "Failed to attach servo on pin %d") \
+    X(PWM_ATTACH_FAILED, "Failed to attach PWM on pin %d") \
+    X(I2C_INIT_FAILED, "Failed to start I2C on SDA %d, SCL %d") \
+    X(EXPANDER_UNKNOWN, "Unknown expander type %s") \
+    X(EXPANDER_NOT_FOUND, "No %s answering at I2C address %u") \
+    X(EXPANDER_STARTED, "%s at I2C address %u, pins from %d") \
+    X(EXPANDER_WRITE_FAILED, "I2C write to %s at address %u failed") \
+    X(SENSORS_CONFIGURED, "%u sensor pins configured") \
+    X(RULES_INSTALLED, "%u rules installed, %u table entries")
+
+namespace LogFormat {
+    #define LOG_FORMAT_ENUM(id, format) id,
+    enum Id : uint16_t {
+        LOG_FORMAT_LIST(LOG_FORMAT_ENUM)
+        COUNT
+    };
+    #undef LOG_FORMAT_ENUM
+
+    const char* formatString(uint16_t id);
+}
+
+#endif
@@ -1,57 +1,207 @@
 // log_manager.cpp
 #include "log_manager.h"
 #include <ArduinoJson.h>
+#include <esp_attr.h>
+#include <esp_system.h>
+#include <vector>
 
 
-std::vector<String> logBuffer;
+const size_t LOG_RING_SIZE = 64;       // Records kept in RAM for /log and the serial drain
+const size_t LOG_CRASH_RING_SIZE = 16; // Records mirrored to RTC memory, survive a reboot
+const uint32_t LOG_CRASH_MAGIC = 0x4C4F4731;
 
+struct CrashRing {
+    uint32_t magic;
+    uint32_t writeCount;
+    LogRecord records[LOG_CRASH_RING_SIZE];
+};
 
-String getCurrentTimestamp() {
-    unsigned long millisSinceStart = millis();  // Get milliseconds since boot
+LogRecord logRing[LOG_RING_SIZE];
+uint32_t logWriteCount = 0;  // Total records written, the ring index is this modulo the size
+uint32_t serialReadCount = 0; // Only touched by drainLogToSerial
+RTC_NOINIT_ATTR CrashRing crashRing; // Not cleared on a software reset or crash
+std::vector<LogRecord> previousBootRecords;
+portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED; // Records are written from several tasks
+
+
+namespace LogFormat {
+    #define LOG_FORMAT_STRING(id, format) format,
+    const char* const formatStrings[] = {
+        LOG_FORMAT_LIST(LOG_FORMAT_STRING)
+    };
+    #undef LOG_FORMAT_STRING
+
+    const char* formatString(uint16_t id) {
+        return id < COUNT ? formatStrings[id] : nullptr;
+    }
+}
+
+
+// Recover the crash ring left by the previous boot, then start a new one
+void initLog() {
+    if (crashRing.magic == LOG_CRASH_MAGIC) {
+        uint32_t count = std::min<uint32_t>(crashRing.writeCount, LOG_CRASH_RING_SIZE);
+        for (uint32_t i = crashRing.writeCount - count; i != crashRing.writeCount; ++i) {
+            previousBootRecords.push_back(crashRing.records[i % LOG_CRASH_RING_SIZE]);
+        }
+    }
+    crashRing.writeCount = 0;
+    crashRing.magic = LOG_CRASH_MAGIC;
+
+    LOG_INFO(BOOT, static_cast<int>(esp_reset_reason()));
+    if (!previousBootRecords.empty()) {
+        LOG_INFO(PREVIOUS_BOOT_RECORDS, previousBootRecords.size());
+    }
+}
+
+
+void commitLogRecord(const LogRecord& record) {
+    portENTER_CRITICAL(&logMux);
+    logRing[logWriteCount % LOG_RING_SIZE] = record;
+    logWriteCount++;
+    crashRing.records[crashRing.writeCount % LOG_CRASH_RING_SIZE] = record;
+    crashRing.writeCount++;
+    portEXIT_CRITICAL(&logMux);
+}
+
+
+String formatTimestamp(uint32_t millisSinceStart) {
     unsigned long totalSeconds = millisSinceStart / 1000;
-    
+
     unsigned long hours = (totalSeconds / 3600) % 24;  // Wraps at 24 hours
     unsigned long minutes = (totalSeconds / 60) % 60;
     unsigned long seconds = totalSeconds % 60;
-    
+
     char timestamp[20];
     snprintf(timestamp, sizeof(timestamp), "%02lu:%02lu:%02lu", hours, minutes, seconds);
     return String(timestamp);
 }
 
 
-String getLog() {
-    DynamicJsonDocument doc(1024);
-    JsonArray logArray = doc.to<JsonArray>();
+String getCurrentTimestamp() {
+    return formatTimestamp(millis()); // Milliseconds since boot
+}
+
+
+// Expand the format string with the recorded arguments
+String formatLogRecord(const LogRecord& record) {
+    String entry = formatTimestamp(record.timestamp) + ": ";
+    const char* format = LogFormat::formatString(record.formatId);
+    if (format == nullptr) {
+        return entry + "unknown log format " + String(record.formatId);
+    }
+
+    size_t argIndex = 0;
+    for (const char* p = format; *p; ++p) {
+        if (*p != '%' || p[1] == '\0') {
+            entry += *p;
+            continue;
+        }
+        char spec = *++p;
+        if (spec == '%') {
+            entry += '%';
+            continue;
+        }
+        if (argIndex >= record.argCount) {
+            entry += '?';
+            continue;
+        }
+        uint32_t arg = record.args[argIndex++];
+        switch (spec) {
+            case 'd':
+                entry += String(static_cast<int32_t>(arg));
+                break;
+            case 'u':
+                entry += String(arg);
+                break;
+            case 's': {
+                uint32_t offset = arg & ~LOG_TEXT_TRUNCATED;
+                if (offset < LOG_TEXT_SIZE) {
+                    // Copy out, the text is only terminated if the writer got to finish it
+                    char text[LOG_TEXT_SIZE + 1];
+                    memcpy(text, record.text + offset, LOG_TEXT_SIZE - offset);
+                    text[LOG_TEXT_SIZE - offset] = '\0';
+                    entry += text;
+                }
+                if (arg & LOG_TEXT_TRUNCATED) {
+                    entry += "...";
+                }
+                break;
+            }
+            case 'I':
+                entry += String(arg & 0xFF) + "." + String((arg >> 8) & 0xFF) + "." +
+                         String((arg >> 16) & 0xFF) + "." + String(arg >> 24);
+                break;
+            default:
+                entry += '%';
+                entry += spec;
+                break;
+        }
+    }
+    return entry;
+}
 
-    for (String& logEntry : logBuffer) {
-        logArray.add(logEntry); // Add log entry to the JSON array
+
+// Copy the newest records out of the ring, oldest first
+std::vector<LogRecord> snapshotLog(size_t limit) {
+    std::vector<LogRecord> records;
+    records.reserve(LOG_RING_SIZE);
+
+    portENTER_CRITICAL(&logMux);
+    uint32_t count = std::min<uint32_t>(logWriteCount, LOG_RING_SIZE);
+    if (limit > 0 && limit < count) {
+        count = limit;
+    }
+    for (uint32_t i = logWriteCount - count; i != logWriteCount; ++i) {
+        records.push_back(logRing[i % LOG_RING_SIZE]);
     }
+    portEXIT_CRITICAL(&logMux);
 
-    String jsonString;
-    serializeJson(doc, jsonString);
-    return jsonString;
+    return records;
 }
 
 
-void AddToLog(const String& message) {
-    // Create a timestamp
-    String timestamp = getCurrentTimestamp();
-    
-    // Construct the log entry
-    String logEntry = timestamp + ": " + message;
+void getLog(JsonDocument& doc, size_t limit) {
+    std::vector<LogRecord> records = snapshotLog(limit);
 
-    // Add the log entry to the vector
-    logBuffer.push_back(logEntry);
+    JsonArray logArray = doc.to<JsonArray>();
 
-    // Ensure the log does not exceed 1024 bytes
-    size_t totalLength = 0;
-    for (const String& entry : logBuffer) {
-        totalLength += entry.length();
+    if (limit == 0) {
+        for (const LogRecord& record : previousBootRecords) {
+            logArray.add("previous boot " + formatLogRecord(record));
+        }
+    }
+    for (const LogRecord& record : records) {
+        logArray.add(formatLogRecord(record)); // Add log entry to the JSON array
     }
+}
+
+
+// Format and print records that were not printed yet. Called from loop(),
+// so the formatting cost stays off the request and control paths.
+void drainLogToSerial() {
+    for (;;) {
+        LogRecord record;
+        uint32_t dropped = 0;
+
+        portENTER_CRITICAL(&logMux);
+        if (logWriteCount - serialReadCount > LOG_RING_SIZE) {
+            dropped = logWriteCount - serialReadCount - LOG_RING_SIZE;
+            serialReadCount += dropped;
+        }
+        bool available = serialReadCount != logWriteCount;
+        if (available) {
+            record = logRing[serialReadCount % LOG_RING_SIZE];
+            serialReadCount++;
+        }
+        portEXIT_CRITICAL(&logMux);
 
-    while (totalLength > 1024 && !logBuffer.empty()) {
-        totalLength -= logBuffer.front().length();
-        logBuffer.erase(logBuffer.begin()); // Remove the oldest entry
+        if (dropped > 0) {
+            Serial.println(String(dropped) + " log records dropped before serial output");
+        }
+        if (!available) {
+            return;
+        }
+        Serial.println(formatLogRecord(record));
     }
 }
@@ -3,9 +3,99 @@
 #define LOG_MANAGER_H
 
 #include <Arduino.h>
+#include <IPAddress.h>
+#include <ArduinoJson.h>
+#include "log_formats.h"
 
+// Log levels, anything above LOG_COMPILE_LEVEL is compiled out.
+// A record holds at most LOG_MAX_ARGS arguments. All %s arguments of a record share
+// LOG_TEXT_SIZE bytes including their terminators; a string cut short is shown ending
+// in "..." and one that got no room at all as "...".
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_AT(level, id, ...) \
+    do { if ((level) <= LOG_COMPILE_LEVEL) logWrite((level), LogFormat::id, ##__VA_ARGS__); } while (0)
+#define LOG_ERROR(id, ...) LOG_AT(LOG_LEVEL_ERROR, id, ##__VA_ARGS__)
+#define LOG_WARN(id, ...)  LOG_AT(LOG_LEVEL_WARN, id, ##__VA_ARGS__)
+#define LOG_INFO(id, ...)  LOG_AT(LOG_LEVEL_INFO, id, ##__VA_ARGS__)
+#define LOG_DEBUG(id, ...) LOG_AT(LOG_LEVEL_DEBUG, id, ##__VA_ARGS__)
+
+const size_t LOG_MAX_ARGS = 4;
+const size_t LOG_TEXT_SIZE = 32;
+const uint32_t LOG_TEXT_TRUNCATED = 0x8000; // Set in a %s argument's offset when the string was cut
+
+// One binary log entry. Strings are copied into text, their args slot holds the offset.
+struct LogRecord {
+    uint32_t timestamp; // millis()
+    uint16_t formatId;
+    uint8_t level;
+    uint8_t argCount;
+    uint32_t args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_SIZE];
+};
+
+void initLog();
+void commitLogRecord(const LogRecord& record);
+String formatLogRecord(const LogRecord& record);
 String getCurrentTimestamp();
-extern void AddToLog(const String &message);
-extern String getLog();
+String formatTimestamp(uint32_t millisSinceStart);
+extern void getLog(JsonDocument& response, size_t limit = 0);
+void drainLogToSerial();
+
+// Argument encoders used by logWrite
+inline void appendLogValue(LogRecord& record, uint32_t value) {
+    if (record.argCount < LOG_MAX_ARGS) {
+        record.args[record.argCount++] = value;
+    }
+}
+inline void appendLogArg(LogRecord& record, size_t&, int value) { appendLogValue(record, value); }
+inline void appendLogArg(LogRecord& record, size_t&, unsigned int value) { appendLogValue(record, value); }
+inline void appendLogArg(LogRecord& record, size_t&, long value) { appendLogValue(record, value); }
+inline void appendLogArg(LogRecord& record, size_t&, unsigned long value) { appendLogValue(record, value); }
+inline void appendLogArg(LogRecord& record, size_t&, const IPAddress& value) {
+    appendLogValue(record, value[0] | (value[1] << 8) | (value[2] << 16) | (static_cast<uint32_t>(value[3]) << 24));
+}
+inline void appendLogArg(LogRecord& record, size_t& textPos, const char* value) {
+    if (record.argCount >= LOG_MAX_ARGS) {
+        return;
+    }
+    if (textPos >= LOG_TEXT_SIZE) {
+        record.args[record.argCount++] = LOG_TEXT_SIZE | LOG_TEXT_TRUNCATED; // Keeps later arguments in place
+        return;
+    }
+    uint32_t& offset = record.args[record.argCount++];
+    offset = textPos;
+    while (*value && textPos < LOG_TEXT_SIZE - 1) {
+        record.text[textPos++] = *value++;
+    }
+    record.text[textPos++] = '\0';
+    if (*value) {
+        offset |= LOG_TEXT_TRUNCATED;
+    }
+}
+inline void appendLogArg(LogRecord& record, size_t& textPos, const String& value) { appendLogArg(record, textPos, value.c_str()); }
+
+// Records the format id, timestamp and raw arguments, no formatting happens here
+template <typename... Args>
+void logWrite(uint8_t level, uint16_t formatId, const Args&... args) {
+    LogRecord record;
+    record.timestamp = millis();
+    record.formatId = formatId;
+    record.level = level;
+    record.argCount = 0;
+    record.text[0] = '\0';
+    size_t textPos = 0;
+    (appendLogArg(record, textPos, args), ...);
+    (void)textPos;
+    commitLogRecord(record);
+}
 
-#endif
\ No newline at end of file
+#endif
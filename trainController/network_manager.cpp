@@ -9,21 +9,32 @@
 #include <FS.h>
 #include <LittleFS.h>
 #include <ESPmDNS.h>
+#include <esp_wifi.h>
+#include <algorithm>
 
 
 namespace NetworkManager2 {
     std::vector<WiFiNetwork> savedNetworks;
-
-    String postConnect(const String& body) {
-        DynamicJsonDocument doc(512);
-        DeserializationError error = deserializeJson(doc, body);
-
-        if (error) {
-            return R"({"error":"Invalid JSON"})";
-        }
-
+    LatencyProfile latencyProfile = {defaultWifiPowerSave, defaultTcpNoDelay, defaultApBeaconIntervalTu, defaultApDtimPeriod};
+
+    // Rolling round trip samples per /ping client, reported by the client itself
+    const size_t PING_CLIENTS = 8;
+    const size_t PING_SAMPLES = 32;
+    const size_t PING_ID_MAX = 32;   // Client ids are echoed and kept per client
+    const size_t PING_TIME_MAX = 20; // Enough for any 64-bit timestamp
+    struct PingClient {
+        String id;
+        unsigned long lastSeen;
+        uint16_t rttTenthsMs[PING_SAMPLES];
+        size_t count;
+        size_t next;
+    };
+    std::vector<PingClient> pingClients;
+
+    void postConnect(JsonDocument& doc, JsonDocument& response) {
         if (!doc.containsKey("ssid")) {
-            return R"({"error":"Missing SSID"})";
+            response["error"] = "Missing SSID";
+            return;
         }
 
         String ssid = doc["ssid"].as<String>();
@@ -39,13 +50,14 @@ namespace NetworkManager2 {
         } else if (doc.containsKey("password")) {
             password = doc["password"].as<String>(); // Use provided password
         } else {
-            return R"({"error":"Missing password for unknown SSID"})";
+            response["error"] = "Missing password for unknown SSID";
+            return;
         }
 
         // Stop AP mode if active
         if (WiFi.getMode() == WIFI_AP) {
             WiFi.softAPdisconnect(true);
-            Serial.println("Stopped AP mode.");
+            LOG_INFO(AP_STOPPED);
         }
 
         // Attempt to connect
@@ -58,34 +70,35 @@ namespace NetworkManager2 {
         }
 
         if (WiFi.status() == WL_CONNECTED) {
-            Serial.println("Connected to WiFi: " + WiFi.localIP().toString());
+            LOG_INFO(WIFI_CONNECTED, WiFi.localIP());
             interval = 0; // Solid LED
-            return R"({"message":"Connected successfully","ip":")" + WiFi.localIP().toString() + R"("})";
+            response["message"] = "Connected successfully";
+            response["ip"] = WiFi.localIP().toString();
         } else {
-            Serial.println("Failed to connect to: " + ssid);
+            LOG_WARN(WIFI_CONNECT_FAILED, ssid);
             WiFi.softAP(deviceID, apPassword); // Restart AP mode
             WiFi.softAPsetHostname(deviceID);
             interval = 250; // Fast blinking
-            return R"({"error":"Failed to connect, AP mode restarted"})";
+            response["error"] = "Failed to connect, AP mode restarted";
         }
     }
 
 
     bool loadNetworksFromStorage() {
         if (!LittleFS.begin(true)) {
-            Serial.println("Failed to initialize LittleFS.");
+            LOG_ERROR(LITTLEFS_INIT_FAILED);
             return false;
         }
 
         File file = LittleFS.open("/networks.json", "r");
         if (!file) {
-            Serial.println("No saved networks found.");
+            LOG_INFO(NO_SAVED_NETWORKS);
             return false;
         }
 
         size_t fileSize = file.size();
         if (fileSize == 0) {
-            Serial.println("Empty networks file.");
+            LOG_WARN(NETWORKS_FILE_EMPTY);
             file.close();
             return false;
         }
@@ -95,7 +108,7 @@ namespace NetworkManager2 {
         DeserializationError error = deserializeJson(doc, file);
 
         if (error) {
-            Serial.println("Failed to parse networks file.");
+            LOG_ERROR(NETWORKS_FILE_PARSE_FAILED);
             file.close();
             return false;
         }
@@ -111,7 +124,7 @@ namespace NetworkManager2 {
 
         file.close();
         savedNetworks = std::move(loadedNetworks);
-        Serial.println("Loaded networks from storage.");
+        LOG_INFO(NETWORKS_LOADED);
         return true;
     }
 
@@ -128,13 +141,13 @@ namespace NetworkManager2 {
 
         File file = LittleFS.open("/networks.json", "w");
         if (!file) {
-            Serial.println("Failed to open networks file for writing.");
+            LOG_ERROR(NETWORKS_FILE_OPEN_FAILED);
             return false;
         }
 
         serializeJson(doc, file);
         file.close();
-        Serial.println("Saved networks to storage.");
+        LOG_INFO(NETWORKS_SAVED);
         return true;
     }
 
@@ -142,18 +155,23 @@ namespace NetworkManager2 {
     bool initializeWiFi() {
         // Initialize LittleFS
         if (!LittleFS.begin(true)) {
-            Serial.println("Failed to mount LittleFS");
+            LOG_ERROR(LITTLEFS_MOUNT_FAILED);
             return false;
         }
 
+        // Apply the latency profile whenever the station connects or the AP starts
+        loadLatencyProfileFromStorage();
+        WiFi.onEvent([](WiFiEvent_t event, WiFiEventInfo_t info) { applyLatencyProfile(); }, ARDUINO_EVENT_WIFI_STA_CONNECTED);
+        WiFi.onEvent([](WiFiEvent_t event, WiFiEventInfo_t info) { applyLatencyProfile(); }, ARDUINO_EVENT_WIFI_AP_START);
+
         // Load stored networks
         if (!loadNetworksFromStorage()) {
-            Serial.println("No networks loaded from storage");
+            LOG_INFO(NO_NETWORKS_LOADED);
         }
 
         // Check if there are saved networks
         if (savedNetworks.empty()) {
-            Serial.println("No saved networks, starting AP mode");
+            LOG_INFO(NO_NETWORKS_AP_MODE);
             startAPMode();
             return false;
         }
@@ -164,10 +182,9 @@ namespace NetworkManager2 {
 
         // Configure mDNS
         if (MDNS.begin(deviceID)) { // Start mDNS with the deviceID as the hostname
-            Serial.println("mDNS responder started. Hostname: " + String(deviceID) + ".local");
-            AddToLog("mDNS responder started. Hostname: " + String(deviceID) + ".local");
+            LOG_INFO(MDNS_STARTED, deviceID);
         } else {
-            Serial.println("Error starting mDNS responder!");
+            LOG_ERROR(MDNS_FAILED);
         }
 
         // Find the default network or fallback to the first stored network
@@ -179,8 +196,7 @@ namespace NetworkManager2 {
 
         // Start connecting
         WiFi.begin(networkToConnect.ssid.c_str(), networkToConnect.password.c_str());
-        Serial.println("Attempting to connect to WiFi: " + networkToConnect.ssid);
-        AddToLog("Attempting to connect to WiFi: " + networkToConnect.ssid);
+        LOG_INFO(WIFI_CONNECTING, networkToConnect.ssid);
 
         unsigned long startAttemptTime = millis();
         while (WiFi.status() != WL_CONNECTED && (millis() - startAttemptTime) < (connectTimeout * 1000)) {
@@ -189,14 +205,12 @@ namespace NetworkManager2 {
 
         // Check connection
         if (WiFi.status() == WL_CONNECTED) {
-            Serial.println("Connected to WiFi: " + WiFi.localIP().toString());
-            AddToLog("Connected to WiFi: " + WiFi.localIP().toString());
+            LOG_INFO(WIFI_CONNECTED, WiFi.localIP());
             isBlinking = false; // Stop blinking, solid LED
 
             return true;
         } else {
-            Serial.println("Failed to connect, starting AP mode");
-            AddToLog("Failed to connect, starting AP mode");
+            LOG_WARN(WIFI_FAILED_AP_MODE);
             startAPMode();
             return false;
         }
@@ -207,14 +221,12 @@ namespace NetworkManager2 {
         WiFi.softAPsetHostname(deviceID);
 
         if (MDNS.begin(deviceID)) { // Start mDNS in AP mode
-            Serial.println("mDNS responder started in AP mode. Hostname: " + String(deviceID) + ".local");
-            AddToLog("mDNS responder started in AP mode. Hostname: " + String(deviceID) + ".local");
+            LOG_INFO(MDNS_AP_STARTED, deviceID);
         } else {
-            Serial.println("Error starting mDNS responder in AP mode!");
-            AddToLog("Error starting mDNS responder in AP mode!");
+            LOG_ERROR(MDNS_AP_FAILED);
         }
 
-        Serial.println("AP Mode started. SSID: " + String(deviceID) + ", Password: " + String(apPassword));
+        LOG_INFO(AP_STARTED, deviceID);
         interval = 250; // Fast blinking for status LED
     }
     
@@ -223,10 +235,10 @@ namespace NetworkManager2 {
             return false; // Not in AP mode, no need to retry
         }
 
-        Serial.println("Attempting to reconnect to stored networks...");
+        LOG_INFO(RECONNECTING);
         
         if (savedNetworks.empty()) {
-            Serial.println("No stored networks to retry.");
+            LOG_INFO(NO_STORED_NETWORKS);
             return false;
         }
 
@@ -238,12 +250,12 @@ namespace NetworkManager2 {
         });
 
         if (defaultNetwork != savedNetworks.end()) {
-            Serial.println("Trying default network: " + defaultNetwork->ssid);
+            LOG_INFO(TRYING_DEFAULT_NETWORK, defaultNetwork->ssid);
             WiFi.begin(defaultNetwork->ssid.c_str(), defaultNetwork->password.c_str());
         } else {
-            Serial.println("No default network, trying all stored networks...");
+            LOG_INFO(TRYING_ALL_NETWORKS);
             for (const auto& network : savedNetworks) {
-                Serial.println("Trying network: " + network.ssid);
+                LOG_INFO(TRYING_NETWORK, network.ssid);
                 WiFi.begin(network.ssid.c_str(), network.password.c_str());
 
                 unsigned long startAttemptTime = millis();
@@ -252,7 +264,7 @@ namespace NetworkManager2 {
                 }
 
                 if (WiFi.status() == WL_CONNECTED) {
-                    Serial.println("Successfully reconnected to: " + WiFi.localIP().toString());
+                    LOG_INFO(RECONNECTED, WiFi.localIP());
                     WiFi.softAPdisconnect(true);  // Disable AP mode
                     isBlinking = false; // Stop LED blinking
                     return true; // Connection successful
@@ -261,7 +273,7 @@ namespace NetworkManager2 {
         }
 
         // If still not connected, revert to AP mode
-        Serial.println("Failed to reconnect, remaining in AP mode.");
+        LOG_WARN(RECONNECT_FAILED);
         WiFi.softAP(deviceID, apPassword);
         WiFi.softAPsetHostname(deviceID);
         interval = 250; // Fast blinking for status LED
@@ -269,8 +281,7 @@ namespace NetworkManager2 {
     }
 
 
-    String getNetworks() {
-        DynamicJsonDocument doc(1024);
+    void getNetworks(JsonDocument& doc) {
         JsonArray array = doc.to<JsonArray>();
 
         for (const auto& network : savedNetworks) {
@@ -278,20 +289,9 @@ namespace NetworkManager2 {
             obj["ssid"] = network.ssid;
             obj["isDefault"] = network.isDefault;
         }
-
-        String response;
-        serializeJson(doc, response);
-        return response;
     }
 
-    String postNetwork(const String& body) {
-        DynamicJsonDocument doc(1024);
-        DeserializationError error = deserializeJson(doc, body);
-
-        if (error) {
-            return "{\"error\":\"Invalid JSON\"}";
-        }
-
+    void postNetwork(JsonDocument& doc, JsonDocument& response) {
         WiFiNetwork newNetwork;
         newNetwork.ssid = doc["ssid"].as<String>();
         newNetwork.password = doc["password"].as<String>();
@@ -314,17 +314,10 @@ namespace NetworkManager2 {
         }
 
         saveNetworksToStorage();
-        return "{\"message\":\"Network added or updated successfully\"}";
+        response["message"] = "Network added or updated successfully";
     }
 
-    String deleteNetwork(const String& body) {
-        DynamicJsonDocument doc(1024);
-        DeserializationError error = deserializeJson(doc, body);
-
-        if (error) {
-            return "{\"error\":\"Invalid JSON\"}";
-        }
-
+    void deleteNetwork(JsonDocument& doc, JsonDocument& response) {
         String ssidToDelete = doc["ssid"].as<String>();
         auto it = std::remove_if(savedNetworks.begin(), savedNetworks.end(), [&](const WiFiNetwork& nw) {
             return nw.ssid == ssidToDelete;
@@ -333,9 +326,151 @@ namespace NetworkManager2 {
         if (it != savedNetworks.end()) {
             savedNetworks.erase(it, savedNetworks.end());
             saveNetworksToStorage();
-            return "{\"message\":\"Network deleted successfully\"}";
+            response["message"] = "Network deleted successfully";
+            return;
+        }
+
+        response["error"] = "Network not found";
+    }
+
+
+    void applyLatencyProfile() {
+        esp_wifi_set_ps(latencyProfile.powerSave ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE);
+
+        if (WiFi.getMode() & WIFI_AP) {
+            wifi_config_t config;
+            if (esp_wifi_get_config(WIFI_IF_AP, &config) == ESP_OK &&
+                (config.ap.beacon_interval != latencyProfile.beaconIntervalTu || config.ap.dtim_period != latencyProfile.dtimPeriod)) {
+                config.ap.beacon_interval = latencyProfile.beaconIntervalTu;
+                config.ap.dtim_period = latencyProfile.dtimPeriod;
+                esp_wifi_set_config(WIFI_IF_AP, &config);
+            }
+        }
+        LOG_INFO(LATENCY_PROFILE_APPLIED, latencyProfile.powerSave ? "on" : "off",
+                 static_cast<unsigned int>(latencyProfile.beaconIntervalTu), static_cast<unsigned int>(latencyProfile.dtimPeriod));
+    }
+
+
+    void getLatencyProfile(JsonDocument& doc) {
+        doc["powerSave"] = latencyProfile.powerSave;
+        doc["noDelay"] = latencyProfile.noDelay;
+        doc["beaconIntervalTu"] = latencyProfile.beaconIntervalTu;
+        doc["dtimPeriod"] = latencyProfile.dtimPeriod;
+    }
+
+
+    void postLatencyProfile(JsonDocument& doc, JsonDocument& response) {
+        LatencyProfile profile = latencyProfile;
+        profile.powerSave = doc["powerSave"] | profile.powerSave;
+        profile.noDelay = doc["noDelay"] | profile.noDelay;
+        int beaconInterval = doc["beaconIntervalTu"] | static_cast<int>(profile.beaconIntervalTu);
+        int dtimPeriod = doc["dtimPeriod"] | static_cast<int>(profile.dtimPeriod);
+
+        if (beaconInterval < 100 || beaconInterval > 60000) {
+            response["error"] = "beaconIntervalTu must be between 100 and 60000";
+            return;
+        }
+        if (dtimPeriod < 1 || dtimPeriod > 10) {
+            response["error"] = "dtimPeriod must be between 1 and 10";
+            return;
+        }
+        profile.beaconIntervalTu = beaconInterval;
+        profile.dtimPeriod = dtimPeriod;
+
+        latencyProfile = profile;
+        applyLatencyProfile();
+        saveLatencyProfileToStorage();
+        response["message"] = "Latency profile updated successfully";
+    }
+
+
+    bool loadLatencyProfileFromStorage() {
+        File file = LittleFS.open("/latency.json", "r");
+        if (!file) {
+            return false;
+        }
+
+        DynamicJsonDocument doc(256);
+        DeserializationError error = deserializeJson(doc, file);
+        file.close();
+        if (error) {
+            return false;
         }
 
-        return "{\"error\":\"Network not found\"}";
+        latencyProfile.powerSave = doc["powerSave"] | latencyProfile.powerSave;
+        latencyProfile.noDelay = doc["noDelay"] | latencyProfile.noDelay;
+        latencyProfile.beaconIntervalTu = doc["beaconIntervalTu"] | latencyProfile.beaconIntervalTu;
+        latencyProfile.dtimPeriod = doc["dtimPeriod"] | latencyProfile.dtimPeriod;
+        return true;
+    }
+
+
+    bool saveLatencyProfileToStorage() {
+        File file = LittleFS.open("/latency.json", "w");
+        if (!file) {
+            return false;
+        }
+        DynamicJsonDocument doc(256);
+        getLatencyProfile(doc);
+        serializeJson(doc, file);
+        file.close();
+        return true;
+    }
+
+
+    // Echo the client timestamp and keep RTT statistics per client.
+    // Clients send the RTT they measured for their previous ping with the next one.
+    int getPing(const String& clientId, const String& clientTime, const String& lastRtt, JsonDocument& doc) {
+        if (clientId.length() > PING_ID_MAX || clientTime.length() > PING_TIME_MAX) {
+            doc["error"] = "id must be at most " + String(PING_ID_MAX) + " and t at most " + String(PING_TIME_MAX) + " characters";
+            return 400;
+        }
+
+        auto it = std::find_if(pingClients.begin(), pingClients.end(), [&](const PingClient& client) {
+            return client.id == clientId;
+        });
+        if (it == pingClients.end()) {
+            if (pingClients.size() >= PING_CLIENTS) {
+                // Forget the client that was quiet the longest
+                it = std::min_element(pingClients.begin(), pingClients.end(), [](const PingClient& a, const PingClient& b) {
+                    return a.lastSeen < b.lastSeen;
+                });
+            } else {
+                pingClients.emplace_back();
+                it = pingClients.end() - 1;
+            }
+            it->id = clientId;
+            it->count = 0;
+            it->next = 0;
+        }
+        it->lastSeen = millis();
+
+        if (lastRtt.length() > 0) {
+            float rtt = lastRtt.toFloat();
+            if (rtt >= 0) {
+                it->rttTenthsMs[it->next] = std::min(rtt * 10.0f, 65535.0f);
+                it->next = (it->next + 1) % PING_SAMPLES;
+                it->count = std::min(it->count + 1, PING_SAMPLES);
+            }
+        }
+
+        doc["t"] = clientTime;
+        doc["serverMs"] = millis();
+        doc["client"] = clientId;
+        doc["samples"] = it->count;
+        if (it->count > 0) {
+            std::vector<uint16_t> samples(it->rttTenthsMs, it->rttTenthsMs + it->count);
+            std::sort(samples.begin(), samples.end());
+            uint32_t sum = 0;
+            for (uint16_t sample : samples) {
+                sum += sample;
+            }
+            doc["minMs"] = samples.front() / 10.0;
+            doc["avgMs"] = sum / 10.0 / samples.size();
+            doc["p50Ms"] = samples[samples.size() / 2] / 10.0;
+            doc["p95Ms"] = samples[std::min(samples.size() - 1, samples.size() * 95 / 100)] / 10.0;
+            doc["maxMs"] = samples.back() / 10.0;
+        }
+        return 200;
     }
 }
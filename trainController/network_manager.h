@@ -3,6 +3,7 @@
 #define NETWORK_MANAGER_H
 
 #include <WiFi.h>
+#include <ArduinoJson.h>
 #include <vector>  // To use std::vector
 #include <string>
 
@@ -13,20 +14,36 @@ struct WiFiNetwork {
     bool isDefault;
 };
 
+// WiFi settings that trade power for latency
+struct LatencyProfile {
+    bool powerSave;            // Modem power save adds 100-300 ms of wake-up latency
+    bool noDelay;              // Disable Nagle on response sockets
+    uint16_t beaconIntervalTu; // AP beacon interval, 1 TU = 1.024 ms
+    uint8_t dtimPeriod;        // AP DTIM period in beacons
+};
+
 // Declare the extern variable for savedNetworks (defined elsewhere)
 extern std::vector<WiFiNetwork> savedNetworks;  // Global storage for networks
 
 namespace NetworkManager2 {
-	  String postConnect(const String& body);
+	  void postConnect(JsonDocument& body, JsonDocument& response);
     bool initializeWiFi();
     bool tryStoredNetworks();
     void startAPMode();
-    String getNetworks();  // GET
-    String postNetwork(const String& body);
-    String deleteNetwork(const String& body);
+    void getNetworks(JsonDocument& response);  // GET
+    void postNetwork(JsonDocument& body, JsonDocument& response);
+    void deleteNetwork(JsonDocument& body, JsonDocument& response);
     // Persistent storage methods
     bool loadNetworksFromStorage();
     bool saveNetworksToStorage();
+    // Latency profile and round trip probe
+    extern LatencyProfile latencyProfile;
+    void applyLatencyProfile();
+    void getLatencyProfile(JsonDocument& response);
+    void postLatencyProfile(JsonDocument& body, JsonDocument& response);
+    bool loadLatencyProfileFromStorage();
+    bool saveLatencyProfileToStorage();
+    int getPing(const String& clientId, const String& clientTime, const String& lastRtt, JsonDocument& response); // HTTP status
 }
 
 #endif
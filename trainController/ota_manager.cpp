@@ -0,0 +1,422 @@
+// ota_manager.cpp
+#include "ota_manager.h"
+#include "log_manager.h"
+#include "inflater.h"
+#include "delta_patch.h"
+#include <Update.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+#include <algorithm>
+#include <atomic>
+
+
+// Keep the new image in PENDING_VERIFY until OtaManager::loop confirms it
+extern "C" bool verifyRollbackLater() {
+    return true;
+}
+
+
+namespace OtaManager {
+
+    // One upload at a time. Upload callbacks, disconnect callbacks and the /update routes
+    // all run on the web server task, so the session needs no locking.
+    struct UpdateSession {
+        AsyncWebServerRequest* owner = nullptr;
+        bool failed = false;
+        bool finished = false;
+        const char* error = nullptr;
+
+        uint8_t outerHead[2];       // Sniffed to detect gzip
+        size_t outerHeadLen = 0;
+        bool outerDecided = false;
+        uint8_t innerHead[DeltaPatcher::MAGIC_SIZE]; // Sniffed to detect a delta
+        size_t innerHeadLen = 0;
+        bool innerDecided = false;
+
+        Inflater* inflater = nullptr;
+        Inflater::Status inflaterStatus = Inflater::NEED_INPUT;
+        DeltaPatcher* patcher = nullptr;
+        DeltaPatcher::Status patcherStatus = DeltaPatcher::NEED_INPUT;
+
+        mbedtls_sha256_context sha;
+        bool hasExpectedHash = false;
+        uint8_t expectedHash[32];
+
+        unsigned long startMs = 0;
+        unsigned long lastActivityMs = 0;
+        uint32_t bytesIn = 0;
+        uint32_t bytesOut = 0;
+        uint32_t heapAtStart = 0;
+        uint32_t minHeap = 0;
+    };
+
+    UpdateSession session;
+
+    // Result of the last finished or failed update, for GET /update
+    struct UpdateResult {
+        const char* state = "idle";
+        String error;
+        uint32_t bytesIn = 0;
+        uint32_t bytesOut = 0;
+        unsigned long durationMs = 0;
+        uint32_t peakRamBytes = 0;
+    };
+
+    UpdateResult lastResult;
+    bool pendingVerify = false;
+    std::atomic<unsigned long> restartAt(0);
+
+
+    void releaseSession() {
+        delete session.inflater;
+        delete session.patcher;
+        session.inflater = nullptr;
+        session.patcher = nullptr;
+        mbedtls_sha256_free(&session.sha);
+        session.owner = nullptr;
+    }
+
+
+    void failSession(const char* error) {
+        if (session.failed) {
+            return;
+        }
+        session.failed = true;
+        session.error = error;
+        if (Update.isRunning()) {
+            Update.abort();
+        }
+        LOG_ERROR(OTA_FAILED, error);
+        lastResult = UpdateResult();
+        lastResult.state = "failed";
+        lastResult.error = error;
+    }
+
+
+    // Compare against OTA_TOKEN without an early exit, so timing does not leak the prefix
+    bool isAuthorized(AsyncWebServerRequest* request) {
+        const char* expected = OTA_TOKEN;
+        size_t expectedLen = strlen(expected);
+        if (expectedLen == 0 || !request->hasHeader("X-OTA-Token")) {
+            return false;
+        }
+        const String& token = request->getHeader("X-OTA-Token")->value();
+        uint8_t difference = token.length() != expectedLen;
+        for (size_t i = 0; i < expectedLen; ++i) {
+            difference |= static_cast<uint8_t>(i < token.length() ? token[i] : 0) ^ static_cast<uint8_t>(expected[i]);
+        }
+        return difference == 0;
+    }
+
+
+    bool parseHash(const String& hex, uint8_t* out) {
+        if (hex.length() != 64) {
+            return false;
+        }
+        for (int i = 0; i < 32; ++i) {
+            char pair[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+            char* end;
+            out[i] = strtoul(pair, &end, 16);
+            if (*end != '\0') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+    // Final stage: hash and write the plain image into the inactive partition
+    bool writeImage(const uint8_t* data, size_t len) {
+        if (!Update.isRunning() && !Update.begin(UPDATE_SIZE_UNKNOWN)) {
+            failSession("Could not start update");
+            return false;
+        }
+        mbedtls_sha256_update(&session.sha, data, len);
+        if (Update.write(const_cast<uint8_t*>(data), len) != len) {
+            failSession(Update.errorString());
+            return false;
+        }
+        session.bytesOut += len;
+        return true;
+    }
+
+
+    bool readRunningImage(uint32_t offset, uint8_t* buffer, size_t len) {
+        const esp_partition_t* running = esp_ota_get_running_partition();
+        if (running == nullptr || offset + len > running->size) {
+            return false;
+        }
+        return esp_partition_read(running, offset, buffer, len) == ESP_OK;
+    }
+
+
+    bool routeImage(const uint8_t* data, size_t len) {
+        if (session.patcher == nullptr) {
+            return writeImage(data, len);
+        }
+        session.patcherStatus = session.patcher->write(data, len);
+        if (session.patcherStatus == DeltaPatcher::FAILED) {
+            failSession(session.patcher->error());
+            return false;
+        }
+        return true;
+    }
+
+
+    // Decompressed stream: detect a delta on the first bytes, then forward
+    bool feedImage(const uint8_t* data, size_t len) {
+        while (!session.innerDecided && len > 0) {
+            session.innerHead[session.innerHeadLen++] = *data++;
+            len--;
+            if (session.innerHeadLen == DeltaPatcher::MAGIC_SIZE) {
+                session.innerDecided = true;
+                if (DeltaPatcher::isDelta(session.innerHead, session.innerHeadLen)) {
+                    session.patcher = new DeltaPatcher(readRunningImage, writeImage);
+                }
+                if (!routeImage(session.innerHead, session.innerHeadLen)) {
+                    return false;
+                }
+            }
+        }
+        return len == 0 || routeImage(data, len);
+    }
+
+
+    bool routeUpload(const uint8_t* data, size_t len) {
+        if (session.inflater == nullptr) {
+            return feedImage(data, len);
+        }
+        session.inflaterStatus = session.inflater->write(data, len);
+        if (session.inflaterStatus == Inflater::FAILED) {
+            failSession(session.failed ? session.error : session.inflater->error());
+            return false;
+        }
+        return true;
+    }
+
+
+    // Uploaded stream: detect gzip on the first bytes, then forward
+    bool feedUpload(const uint8_t* data, size_t len) {
+        while (!session.outerDecided && len > 0) {
+            session.outerHead[session.outerHeadLen++] = *data++;
+            len--;
+            if (session.outerHeadLen == sizeof(session.outerHead)) {
+                session.outerDecided = true;
+                if (session.outerHead[0] == 0x1F && session.outerHead[1] == 0x8B) {
+                    session.inflater = new Inflater(feedImage);
+                }
+                if (!routeUpload(session.outerHead, session.outerHeadLen)) {
+                    return false;
+                }
+            }
+        }
+        return len == 0 || routeUpload(data, len);
+    }
+
+
+    void startSession(AsyncWebServerRequest* request) {
+        session = UpdateSession();
+        session.owner = request;
+        session.startMs = millis();
+        session.heapAtStart = ESP.getFreeHeap();
+        session.minHeap = session.heapAtStart;
+        mbedtls_sha256_init(&session.sha);
+        mbedtls_sha256_starts(&session.sha, 0);
+
+        // A client that goes away mid upload never reaches handleUploadRequest
+        request->onDisconnect([request]() {
+            if (session.owner == request) {
+                failSession("Upload disconnected");
+                releaseSession();
+            }
+        });
+
+        String hash;
+        if (request->hasHeader("X-Image-SHA256")) {
+            hash = request->getHeader("X-Image-SHA256")->value();
+        } else if (request->hasParam("sha256")) {
+            hash = request->getParam("sha256")->value();
+        }
+        if (hash.length() > 0) {
+            session.hasExpectedHash = parseHash(hash, session.expectedHash);
+            if (!session.hasExpectedHash) {
+                failSession("Invalid sha256");
+            }
+        }
+        LOG_INFO(OTA_STARTED);
+    }
+
+
+    void finishSession() {
+        if (!session.outerDecided || !session.innerDecided) {
+            failSession("Image too small");
+            return;
+        }
+        if (session.inflater != nullptr && session.inflaterStatus != Inflater::DONE) {
+            failSession("Truncated gzip stream");
+            return;
+        }
+        if (session.patcher != nullptr && session.patcherStatus != DeltaPatcher::DONE) {
+            failSession("Truncated delta");
+            return;
+        }
+
+        uint8_t hash[32];
+        mbedtls_sha256_finish(&session.sha, hash);
+        if (session.hasExpectedHash && memcmp(hash, session.expectedHash, sizeof(hash)) != 0) {
+            failSession("sha256 mismatch");
+            return;
+        }
+        if (!Update.end(true)) {
+            failSession(Update.errorString());
+            return;
+        }
+
+        session.finished = true;
+        unsigned long duration = millis() - session.startMs;
+        uint32_t peakRam = session.heapAtStart - session.minHeap;
+        LOG_INFO(OTA_FINISHED, session.bytesOut, duration, peakRam);
+        lastResult = UpdateResult();
+        lastResult.state = "written";
+        lastResult.bytesIn = session.bytesIn;
+        lastResult.bytesOut = session.bytesOut;
+        lastResult.durationMs = duration;
+        lastResult.peakRamBytes = peakRam;
+    }
+
+
+    void handleUpload(AsyncWebServerRequest* request, const String& filename, size_t index, uint8_t* data, size_t len, bool final) {
+        if (index == 0) {
+            if (!isAuthorized(request)) {
+                return; // Never touches the session, rejected in handleUploadRequest
+            }
+            if (session.owner != nullptr && session.owner != request) {
+                if (millis() - session.lastActivityMs < OTA_STALE_MS) {
+                    return; // Another update is running, this one is rejected in handleUploadRequest
+                }
+                failSession("Upload abandoned");
+                releaseSession();
+            }
+            startSession(request);
+        }
+        if (session.owner != request || session.failed) {
+            return;
+        }
+
+        session.lastActivityMs = millis();
+        session.bytesIn += len;
+        if (len > 0 && !feedUpload(data, len)) {
+            return;
+        }
+        session.minHeap = std::min<uint32_t>(session.minHeap, ESP.getFreeHeap());
+
+        if (final) {
+            finishSession();
+        }
+    }
+
+
+    void describeResult(JsonObject target) {
+        target["state"] = lastResult.state;
+        if (lastResult.error.length() > 0) {
+            target["error"] = lastResult.error;
+        }
+        if (strcmp(lastResult.state, "written") == 0) {
+            target["bytesIn"] = lastResult.bytesIn;
+            target["bytesOut"] = lastResult.bytesOut;
+            target["durationMs"] = lastResult.durationMs;
+            target["peakRamBytes"] = lastResult.peakRamBytes;
+        }
+    }
+
+
+    // 0 if the request may change the firmware, otherwise the HTTP status to refuse it with
+    int checkAuthorization(AsyncWebServerRequest* request, JsonDocument& response) {
+        if (strlen(OTA_TOKEN) == 0) {
+            response["error"] = "Updates are disabled, no OTA_TOKEN configured";
+            return 403;
+        }
+        if (!isAuthorized(request)) {
+            response["error"] = "Missing or wrong X-OTA-Token";
+            return 401;
+        }
+        return 0;
+    }
+
+
+    int handleUploadRequest(AsyncWebServerRequest* request, JsonDocument& response) {
+        if (int refused = checkAuthorization(request, response)) {
+            return refused;
+        }
+        if (session.owner != request) {
+            response["error"] = "Another update is in progress";
+            return 409;
+        }
+
+        bool succeeded = session.finished && !session.failed;
+        releaseSession();
+        describeResult(response.to<JsonObject>());
+        if (!succeeded) {
+            return 400;
+        }
+
+        restartAt = millis() + OTA_RESTART_DELAY_MS; // Give the response time to go out
+        return 200;
+    }
+
+
+    void getStatus(JsonDocument& response) {
+        const esp_partition_t* running = esp_ota_get_running_partition();
+        response["running"] = running != nullptr ? running->label : "?";
+        response["pendingVerify"] = pendingVerify;
+        response["canRollBack"] = Update.canRollBack();
+        describeResult(response.createNestedObject("lastUpdate"));
+    }
+
+
+    int postRollback(AsyncWebServerRequest* request, JsonDocument& response) {
+        if (int refused = checkAuthorization(request, response)) {
+            return refused;
+        }
+        if (session.owner != nullptr) {
+            response["error"] = "An update is in progress";
+            return 409;
+        }
+        if (!Update.canRollBack() || !Update.rollBack()) {
+            response["error"] = "No previous image to roll back to";
+            return 400;
+        }
+        LOG_WARN(OTA_ROLLBACK);
+        restartAt = millis() + OTA_RESTART_DELAY_MS;
+        response["message"] = "Rolling back, restarting";
+        return 200;
+    }
+
+
+    void begin() {
+        const esp_partition_t* running = esp_ota_get_running_partition();
+        esp_ota_img_states_t state;
+        if (running != nullptr && esp_ota_get_state_partition(running, &state) == ESP_OK) {
+            pendingVerify = state == ESP_OTA_IMG_PENDING_VERIFY;
+        }
+        if (pendingVerify) {
+            LOG_WARN(OTA_PENDING_VERIFY, OTA_CONFIRM_DELAY_MS);
+        }
+    }
+
+
+    void loop(unsigned long currentMillis) {
+        if (pendingVerify && currentMillis >= OTA_CONFIRM_DELAY_MS) {
+            pendingVerify = false;
+            if (esp_ota_mark_app_valid_cancel_rollback() == ESP_OK) {
+                LOG_INFO(OTA_CONFIRMED);
+            }
+        }
+
+        unsigned long restart = restartAt;
+        if (restart != 0 && (long)(currentMillis - restart) >= 0) {
+            ESP.restart();
+        }
+    }
+}
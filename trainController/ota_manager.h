@@ -0,0 +1,32 @@
+// ota_manager.h
+#ifndef OTA_MANAGER_H
+#define OTA_MANAGER_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <ArduinoJson.h>
+
+// Every upload must send this in the X-OTA-Token header. Updates are refused while it is
+// empty, so set it here or build with -DOTA_TOKEN=\"...\" before flashing.
+#ifndef OTA_TOKEN
+#define OTA_TOKEN ""
+#endif
+
+namespace OtaManager {
+    // A new image has this long to prove it runs before it is marked valid.
+    // If it crashes or hangs before then, the bootloader rolls back.
+    const unsigned long OTA_CONFIRM_DELAY_MS = 30000;
+    const unsigned long OTA_RESTART_DELAY_MS = 1000;
+    const unsigned long OTA_STALE_MS = 10000; // An upload without data for this long is abandoned
+
+    void begin();
+    void loop(unsigned long currentMillis);
+
+    // POST /update, multipart upload of a raw, gzip or gzip+delta image
+    void handleUpload(AsyncWebServerRequest* request, const String& filename, size_t index, uint8_t* data, size_t len, bool final);
+    int handleUploadRequest(AsyncWebServerRequest* request, JsonDocument& response); // Returns the HTTP status
+    void getStatus(JsonDocument& response);
+    int postRollback(AsyncWebServerRequest* request, JsonDocument& response); // Returns the HTTP status
+}
+
+#endif
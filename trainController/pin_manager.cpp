@@ -2,10 +2,20 @@
 #include "pin_manager.h"
 #include "input_config.h"
 #include "log_manager.h"
+#include "control_task.h"
+#include "led_pipeline.h"
+#include "strip_buffers.h"
+#include "throttle_manager.h"
+#include "servo_manager.h"
+#include "expander_manager.h"
+#include "rules_manager.h"
 #include <ArduinoJson.h>
 #include <FastLED.h>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 #include "esp32-hal-ledc.h"
+#include <soc/soc_caps.h>
 
 
 namespace PinManager {
@@ -13,56 +23,274 @@ namespace PinManager {
     // FastLED configuration
     std::vector<CRGB*> fastLeds;
 
+    // Gamma corrected, power limited and dithered copies of fastLeds, these are what the strips show.
+    // Aligned with fastLeds and rebuilt with it. Only used on the control task.
+    std::vector<CRGB*> ledFrames;
+
+    // Output values as last written, aligned with digitalPins and pwmPins (duty 0-255).
+    // The control task publishes them under stateMutex, so getPinValues never reads a pin.
+    std::vector<int> digitalValues;
+    std::vector<int> pwmDuties;
+
+    // PWM and servo pins of the last designation whose LEDC channel could not be attached.
+    // They are dropped from pwmPins and servoPins and reported by getPinDesignation.
+    std::vector<int> failedPins;
+
+    // FastLED takes the data pin as a template argument, so every pin gets its own controller.
+    // A controller is registered the first time its pin drives a strip and re-pointed after that.
+    CLEDController* ledControllers[SOC_GPIO_PIN_COUNT] = {};
+    uint32_t ledFrameMs = ControlTask::LED_FRAME_MS; // Control task only, set with the strips
+    std::atomic<uint32_t> ledRequestedMa(0);
+    std::atomic<uint32_t> ledScaleQ16(LedPipeline::SCALE_ONE);
+
+    // Guards the pin lists and fastLeds. Only the control task writes them, it reads
+    // them without the lock and takes it only to publish changes, never around pin I/O.
+    // Web handlers take it briefly to read or validate.
+    std::mutex stateMutex;
+
+    // Order that sorts a pin list, used to keep per-pin lists aligned with it
+    std::vector<size_t> sortOrder(const std::vector<int>& pins) {
+        std::vector<size_t> order(pins.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return pins[a] < pins[b]; });
+        return order;
+    }
+
+    template <typename T>
+    void applyOrder(std::vector<T>& values, const std::vector<size_t>& order) {
+        std::vector<T> sorted;
+        for (size_t i : order) {
+            if (i < values.size()) sorted.push_back(values[i]);
+        }
+        values.swap(sorted);
+    }
+
+    // Sort fastLedPins, keeping numLeds and fastLedType aligned with it
+    void sortFastLedConfig(std::vector<int>& pins, std::vector<int>& counts, std::vector<std::string>& types) {
+        std::vector<size_t> order = sortOrder(pins);
+        applyOrder(pins, order);
+        applyOrder(counts, order);
+        applyOrder(types, order);
+    }
+
+    // Sort analogPins, keeping analogBindings aligned with it
+    void sortAnalogConfig(std::vector<int>& pins, std::vector<int>& bindings) {
+        std::vector<size_t> order = sortOrder(pins);
+        applyOrder(pins, order);
+        applyOrder(bindings, order);
+    }
+
+    // Sort servoPins, keeping servoCalibrations aligned with it
+    void sortServoConfig(std::vector<int>& pins, std::vector<ServoCalibration>& calibrations) {
+        std::vector<size_t> order = sortOrder(pins);
+        applyOrder(pins, order);
+        applyOrder(calibrations, order);
+    }
+
+    bool containsPin(const std::vector<int>& pins, int pin) {
+        return std::find(pins.begin(), pins.end(), pin) != pins.end();
+    }
+
+    // Digital and PWM outputs on a native pin or an expander pin. Expander writes
+    // only update its shadow registers, the control task flushes them once per tick.
+    void attachDigitalOutput(int pin) {
+        if (ExpanderManager::isVirtualPin(pin)) {
+            ExpanderManager::writeDigital(pin, LOW);
+            ExpanderManager::setOutput(pin, true);
+        } else {
+            pinMode(pin, OUTPUT);
+            digitalWrite(pin, LOW);
+        }
+    }
+
+    void writeDigitalOutput(int pin, int value) {
+        if (ExpanderManager::isVirtualPin(pin)) {
+            ExpanderManager::writeDigital(pin, value);
+        } else {
+            digitalWrite(pin, value);
+        }
+    }
+
+    bool attachPwmOutput(int pin) {
+        if (ExpanderManager::isVirtualPin(pin)) {
+            ExpanderManager::writePwm(pin, 0);
+        } else {
+            if (!ledcAttach(pin, 5000, 8)) { // 5 kHz frequency, 8-bit resolution
+                LOG_ERROR(PWM_ATTACH_FAILED, pin);
+                return false;
+            }
+            ledcWrite(pin, 0);
+        }
+        return true;
+    }
+
+    void detachPwmOutput(int pin) {
+        if (ExpanderManager::isVirtualPin(pin)) {
+            ExpanderManager::writePwm(pin, 0);
+        } else {
+            ledcWrite(pin, 0);
+            ledcDetach(pin);
+        }
+    }
+
+    // Percent, 0-100
+    void writePwmOutput(int pin, int value) {
+        if (ExpanderManager::isVirtualPin(pin)) {
+            ExpanderManager::writePwm(pin, value);
+        } else {
+            ledcWrite(pin, map(value, 0, 100, 0, 255));
+        }
+    }
+
+    // Remove pins that failed to attach, and their calibrations when given
+    void dropFailedPins(std::vector<int>& pins, std::vector<ServoCalibration>* calibrations, const std::vector<int>& failed) {
+        for (size_t i = pins.size(); i-- > 0;) {
+            if (containsPin(failed, pins[i])) {
+                pins.erase(pins.begin() + i);
+                if (calibrations != nullptr && i < calibrations->size()) {
+                    calibrations->erase(calibrations->begin() + i);
+                }
+            }
+        }
+    }
+
+    // Store a written value for getPinValues, under the lock because it reads them
+    void publishValue(const std::vector<int>& pins, std::vector<int>& values, int pin, int value) {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        auto it = std::find(pins.begin(), pins.end(), pin);
+        if (it != pins.end() && size_t(it - pins.begin()) < values.size()) {
+            values[it - pins.begin()] = value;
+        }
+    }
+
+    // Values for a new pin list: kept pins keep theirs, new pins start at 0
+    std::vector<int> carryValues(const std::vector<int>& oldPins, const std::vector<int>& oldValues,
+                                 const std::vector<int>& newPins) {
+        std::vector<int> values(newPins.size(), 0);
+        for (size_t i = 0; i < newPins.size(); ++i) {
+            auto it = std::find(oldPins.begin(), oldPins.end(), newPins[i]);
+            if (it != oldPins.end() && size_t(it - oldPins.begin()) < oldValues.size()) {
+                values[i] = oldValues[it - oldPins.begin()];
+            }
+        }
+        return values;
+    }
+
+    // Send a strip's frame buffer out on its pin
+    void attachStrip(int pin, CRGB* frame, int count) {
+        if (pin < 0 || pin >= SOC_GPIO_PIN_COUNT) {
+            return;
+        }
+        if (ledControllers[pin] != nullptr) {
+            ledControllers[pin]->setLeds(frame, count);
+            return;
+        }
+        switch (pin) {
+            #define LED_CONTROLLER_CASE(p) \
+                case p: ledControllers[p] = &FastLED.addLeds<WS2812, p, GRB>(frame, count); break;
+            LED_CONTROLLER_CASE(0) LED_CONTROLLER_CASE(1) LED_CONTROLLER_CASE(2) LED_CONTROLLER_CASE(3)
+            LED_CONTROLLER_CASE(4) LED_CONTROLLER_CASE(5) LED_CONTROLLER_CASE(6) LED_CONTROLLER_CASE(7)
+            LED_CONTROLLER_CASE(8) LED_CONTROLLER_CASE(9) LED_CONTROLLER_CASE(10)
+            LED_CONTROLLER_CASE(20) LED_CONTROLLER_CASE(21)
+            #undef LED_CONTROLLER_CASE
+            default:
+                LOG_WARN(FASTLED_PIN_UNSUPPORTED, pin);
+                break;
+        }
+    }
+
+    // Frame interval the wire time of all strips allows
+    void updateLedFrameInterval() {
+        size_t ledCount = 0;
+        for (size_t i = 0; i < fastLeds.size() && i < numLeds.size(); ++i) {
+            ledCount += numLeds[i];
+        }
+        ledFrameMs = LedPipeline::frameIntervalMs(ledCount, ControlTask::LED_FRAME_MS, ControlTask::LED_SHOW_SHARE);
+    }
+
+    // Turn a strip off and stop driving its pin, FastLED.show skips controllers without LEDs
+    void detachStrip(int pin, int count) {
+        if (pin < 0 || pin >= SOC_GPIO_PIN_COUNT || ledControllers[pin] == nullptr) {
+            return;
+        }
+        ledControllers[pin]->showColor(CRGB::Black, count, 0);
+        ledControllers[pin]->setLeds(nullptr, 0);
+    }
+
 	// Function to initialize the pins
     void initializePins() {
-    Serial.println("Initializing pins.");
-    AddToLog("Initializing pins.");
+    LOG_INFO(PINS_INITIALIZING);
+        LedPipeline::init(ledGamma);
+
+        // Start the I2C expanders first, their pins join availablePins and SDA/SCL reservedPins
+        ExpanderManager::begin();
 
 		// Sort all vectors
 		std::sort(pwmPins.begin(), pwmPins.end());
 		std::sort(digitalPins.begin(), digitalPins.end());
-		std::sort(fastLedPins.begin(), fastLedPins.end());
+		sortFastLedConfig(fastLedPins, numLeds, fastLedType);
+		sortAnalogConfig(analogPins, analogBindings);
+		servoCalibrations.resize(servoPins.size(), defaultServoCalibration);
+		sortServoConfig(servoPins, servoCalibrations);
+		std::sort(sensorPins.begin(), sensorPins.end());
 		std::sort(reservedPins.begin(), reservedPins.end());
 		
         // Configure PWM pins
-        for (size_t i = 0; i < pwmPins.size(); i++) {
-            int channel = i; // Assign a unique PWM channel
-            ledcAttach(pwmPins[i], 5000, 8); // 5 kHz frequency, 8-bit resolution
-            ledcWrite(pwmPins[i], 0); // Initialize as OFF
+        failedPins.clear();
+        for (int pin : pwmPins) {
+            if (!attachPwmOutput(pin)) { // Initialize as OFF
+                failedPins.push_back(pin);
+            }
         }
+        dropFailedPins(pwmPins, nullptr, failedPins);
+        digitalValues.assign(digitalPins.size(), LOW);
+        pwmDuties.assign(pwmPins.size(), 0);
 
         // Configure digital pins
         for (int pin : digitalPins) {
-            pinMode(pin, OUTPUT);
-            digitalWrite(pin, LOW); // Initialize as OFF
+            attachDigitalOutput(pin); // Initialize as OFF
         }
 
-        // Configure FastLED pins
-        fastLeds.clear();
+        // Configure FastLED pins, each strip shows its ledFrames buffer
+        cleanupFastLED();
         for (size_t i = 0; i < fastLedPins.size(); ++i) {
-            fastLeds.push_back(new CRGB[numLeds[i]]);
-            // FastLED.addLeds<WS2812, fastLedPins[i]>(fastLeds[i], numLeds[i]);
-            FastLED.clear(true);
+            fastLeds.push_back(StripBuffers::allocate<CRGB>(numLeds[i]));
+            ledFrames.push_back(StripBuffers::allocate<CRGB>(numLeds[i]));
+            attachStrip(fastLedPins[i], ledFrames[i], numLeds[i]);
         }
+        updateLedFrameInterval();
+        FastLED.show(); // All black
+
+        // Configure analog throttle inputs
+        ThrottleManager::configure(analogPins, analogBindings);
+
+        // Configure servos, they start at position 0
+        std::vector<int> failedServos = ServoManager::configure(servoPins, servoCalibrations);
+        dropFailedPins(servoPins, &servoCalibrations, failedServos);
+        failedPins.insert(failedPins.end(), failedServos.begin(), failedServos.end());
+
+        // Configure sensor inputs, their edges trigger the rules
+        RulesManager::configureSensors(sensorPins);
 
         // Configure status LEDs
         pinMode(statusLedPin, OUTPUT);
         digitalWrite(statusLedPin, LOW); // Start with LED off
         
-        Serial.println("Pins initialized.");
-        AddToLog("Pins initialized.");
+        LOG_INFO(PINS_INITIALIZED);
     }
 
 
 	// Function to clean up FastLED
     void cleanupFastLED() {
-        // Free memory allocated for FastLED
-        for (CRGB* leds : fastLeds) {
-            delete[] leds;
+        for (size_t i = 0; i < fastLedPins.size() && i < numLeds.size(); ++i) {
+            detachStrip(fastLedPins[i], numLeds[i]);
         }
-        fastLeds.clear();
-        Serial.println("FastLED memory cleaned up.");
-        AddToLog("FastLED memory cleaned up.");
+        // Free memory allocated for FastLED
+        StripBuffers::release(fastLeds);
+        StripBuffers::release(ledFrames);
+        LOG_DEBUG(FASTLED_CLEANED_UP);
     }
 
 
@@ -71,35 +299,76 @@ namespace PinManager {
       //// Clear values for pins to ensure clean state
 		  // pwmPins
       for (int pin : pwmPins) {
-          ledcWrite(pin, 0); // Reset PWM pins to 0
+          writePwmOutput(pin, 0); // Reset PWM pins to 0
       }
 		  pwmPins.clear();
+		  pwmDuties.clear();
 		
       // digitalPins
       for (int pin : digitalPins) {
-          digitalWrite(pin, LOW); // Reset digital pins to LOW
+          writeDigitalOutput(pin, LOW); // Reset digital pins to LOW
       }
       digitalPins.clear();
+      digitalValues.clear();
 		
 		//fastLedPins
-    for (size_t i = 0; i < fastLeds.size(); ++i) {
-        fill_solid(fastLeds[i], numLeds[i], CRGB::Black); // Turn off FastLEDs
-    }
-    FastLED.show();
+		cleanupFastLED(); // Turn the strips off and free their buffers
 		fastLedPins.clear();
 		fastLedType.clear();
 		numLeds.clear();
-		cleanupFastLED(); // Clean up previous FastLED setup
+
+		analogPins.clear();
+		analogBindings.clear();
+		ThrottleManager::configure(analogPins, analogBindings);
+
+		servoPins.clear();
+		servoCalibrations.clear();
+		ServoManager::configure(servoPins, servoCalibrations);
+		failedPins.clear();
+
+		sensorPins.clear();
+		RulesManager::configureSensors(sensorPins);
 		
-    Serial.println("Pins reset.");
-    AddToLog("Pins reset.");
+    LOG_INFO(PINS_RESET);
     }
 
 
+  // Pin numbers used as keys are copied into the document
+  const size_t PIN_KEY_SIZE = 8;
+
+  size_t pinDesignationCapacity() {
+      std::lock_guard<std::mutex> lock(stateMutex);
+      return JSON_OBJECT_SIZE(11) + JSON_ARRAY_SIZE(failedPins.size()) +
+             JSON_ARRAY_SIZE(digitalPins.size()) + JSON_ARRAY_SIZE(pwmPins.size()) + JSON_ARRAY_SIZE(fastLedPins.size()) +
+             JSON_ARRAY_SIZE(analogPins.size()) + JSON_OBJECT_SIZE(analogPins.size()) + analogPins.size() * PIN_KEY_SIZE +
+             JSON_ARRAY_SIZE(servoPins.size()) + JSON_OBJECT_SIZE(servoPins.size()) +
+             servoPins.size() * (JSON_OBJECT_SIZE(3) + PIN_KEY_SIZE) +
+             JSON_ARRAY_SIZE(sensorPins.size()) + JSON_ARRAY_SIZE(reservedPins.size()) + JSON_ARRAY_SIZE(availablePins.size());
+  }
+
+
+  size_t pinValuesCapacity() {
+      std::lock_guard<std::mutex> lock(stateMutex);
+      size_t typeSize = 0;
+      for (const std::string& type : fastLedType) {
+          typeSize += type.size() + 1;
+      }
+      return JSON_OBJECT_SIZE(8) +
+             JSON_OBJECT_SIZE(digitalPins.size()) + digitalPins.size() * PIN_KEY_SIZE +
+             JSON_OBJECT_SIZE(pwmPins.size()) + pwmPins.size() * PIN_KEY_SIZE +
+             JSON_ARRAY_SIZE(fastLedPins.size()) + fastLedPins.size() * (JSON_OBJECT_SIZE(4) + JSON_ARRAY_SIZE(3)) + typeSize +
+             JSON_OBJECT_SIZE(analogPins.size()) + analogPins.size() * (JSON_OBJECT_SIZE(3) + PIN_KEY_SIZE) +
+             JSON_OBJECT_SIZE(servoPins.size()) + servoPins.size() * (JSON_OBJECT_SIZE(3) + PIN_KEY_SIZE) +
+             JSON_OBJECT_SIZE(sensorPins.size()) + sensorPins.size() * PIN_KEY_SIZE +
+             JSON_ARRAY_SIZE(expanders.size()) + expanders.size() * JSON_OBJECT_SIZE(8) +
+             JSON_OBJECT_SIZE(3);
+  }
+
+
   // Get pin designations
-  String getPinDesignation() {
-      DynamicJsonDocument doc(1024);
-      
+  void getPinDesignation(JsonDocument& doc) {
+      std::lock_guard<std::mutex> lock(stateMutex);
+
       // Create arrays for each pin type
       JsonArray digitalArray = doc.createNestedArray("digitalPins");
       for (int pin : digitalPins) {
@@ -116,40 +385,67 @@ namespace PinManager {
           fastLedArray.add(pin);
       }
 
+      JsonArray analogArray = doc.createNestedArray("analogPins");
+      for (int pin : analogPins) {
+          analogArray.add(pin);
+      }
+
+      JsonObject bindingObj = doc.createNestedObject("analogBindings");
+      for (size_t i = 0; i < analogPins.size() && i < analogBindings.size(); ++i) {
+          if (analogBindings[i] >= 0) {
+              bindingObj[String(analogPins[i])] = analogBindings[i];
+          }
+      }
+
+      JsonArray servoArray = doc.createNestedArray("servoPins");
+      JsonObject calibrationObj = doc.createNestedObject("servoCalibrations");
+      for (size_t i = 0; i < servoPins.size() && i < servoCalibrations.size(); ++i) {
+          servoArray.add(servoPins[i]);
+          JsonObject calibration = calibrationObj.createNestedObject(String(servoPins[i]));
+          calibration["minUs"] = servoCalibrations[i].minUs;
+          calibration["maxUs"] = servoCalibrations[i].maxUs;
+          calibration["speed"] = servoCalibrations[i].speed;
+      }
+
+      JsonArray sensorArray = doc.createNestedArray("sensorPins");
+      for (int pin : sensorPins) {
+          sensorArray.add(pin);
+      }
+
       JsonArray reservedArray = doc.createNestedArray("reservedPins");
       for (int pin : reservedPins) {
           reservedArray.add(pin);
       }
 
+      // Accepted but left out because no LEDC channel could be attached
+      JsonArray failedArray = doc.createNestedArray("failedPins");
+      for (int pin : failedPins) {
+          failedArray.add(pin);
+      }
+
       JsonArray availableArray = doc.createNestedArray("availablePins");
       for (int pin : availablePins) {
           availableArray.add(pin);
       }
-
-      String response;
-      serializeJson(doc, response);
-      return response;
   }
 
 
 
-  // Post pin designation
-  String postPinDesignation(const String& body) {
-      Serial.println("postPinDesignation started.");
-      AddToLog("postPinDesignation started.");
-    
-      DynamicJsonDocument doc(1024);
-      DeserializationError error = deserializeJson(doc, body);
-
-      if (error) {
-          return R"({"error":"Invalid JSON", "details":")" + String(error.c_str()) + R"("})";
-      }
+  // Post pin designation, returns the HTTP status
+  int postPinDesignation(JsonDocument& doc, JsonDocument& response) {
+      LOG_DEBUG(PIN_DESIGNATION_STARTED);
 
       JsonObject root = doc.as<JsonObject>();
 
       std::vector<int> inputDigitalPins;
       std::vector<int> inputPwmPins;
       std::vector<int> inputFastLedPins;
+      std::vector<int> inputNumLeds;
+      std::vector<int> inputAnalogPins;
+      std::vector<int> inputAnalogBindings;
+      std::vector<int> inputServoPins;
+      std::vector<ServoCalibration> inputServoCalibrations;
+      std::vector<int> inputSensorPins;
 
       // Parse pins
       if (root.containsKey("digitalPins")) {
@@ -173,123 +469,345 @@ namespace PinManager {
           }
       }
 
-      // Check for duplicate pins across lists
-      std::vector<int> duplicates;
-      for (int pin : inputDigitalPins) {
-          if (std::find(inputPwmPins.begin(), inputPwmPins.end(), pin) != inputPwmPins.end() ||
-              std::find(inputFastLedPins.begin(), inputFastLedPins.end(), pin) != inputFastLedPins.end()) {
-              duplicates.push_back(pin);
+      if (root.containsKey("analogPins")) {
+          JsonArray analogArray = root["analogPins"].as<JsonArray>();
+          for (JsonVariant value : analogArray) {
+              inputAnalogPins.push_back(value.as<int>());
           }
       }
-      for (int pin : inputPwmPins) {
-          if (std::find(inputFastLedPins.begin(), inputFastLedPins.end(), pin) != inputFastLedPins.end()) {
-              duplicates.push_back(pin);
+
+      if (root.containsKey("servoPins")) {
+          JsonArray servoArray = root["servoPins"].as<JsonArray>();
+          for (JsonVariant value : servoArray) {
+              inputServoPins.push_back(value.as<int>());
+          }
+      }
+
+      if (root.containsKey("sensorPins")) {
+          JsonArray sensorArray = root["sensorPins"].as<JsonArray>();
+          for (JsonVariant value : sensorArray) {
+              inputSensorPins.push_back(value.as<int>());
+          }
+      }
+
+      // Optional LED count per fastLed pin, 0 keeps the current count
+      inputNumLeds.assign(inputFastLedPins.size(), 0);
+      if (root.containsKey("numLeds")) {
+          JsonArray numLedsArray = root["numLeds"].as<JsonArray>();
+          if (numLedsArray.size() != inputFastLedPins.size()) {
+              response["error"] = "numLeds must have one entry per fastLed pin";
+              return 400;
+          }
+          for (size_t i = 0; i < numLedsArray.size(); ++i) {
+              int count = numLedsArray[i].as<int>();
+              if (count < 1 || count > maxLedsPerStrip) {
+                  response["error"] = "numLeds must be between 1 and " + String(maxLedsPerStrip);
+                  return 400;
+              }
+              inputNumLeds[i] = count;
+          }
+      }
+
+      // Optional PWM pin driven by each analog pin, as {"analogPin": pwmPin}
+      inputAnalogBindings.assign(inputAnalogPins.size(), -1);
+      if (root.containsKey("analogBindings")) {
+          for (JsonPair kv : root["analogBindings"].as<JsonObject>()) {
+              int analogPin = String(kv.key().c_str()).toInt();
+              int pwmPin = kv.value().as<int>();
+              auto it = std::find(inputAnalogPins.begin(), inputAnalogPins.end(), analogPin);
+              if (it == inputAnalogPins.end()) {
+                  response["error"] = "Binding for pin " + String(analogPin) + " which is not an analog pin";
+                  return 400;
+              }
+              if (!containsPin(inputPwmPins, pwmPin) || ExpanderManager::isVirtualPin(pwmPin)) {
+                  response["error"] = "Analog pin " + String(analogPin) + " must be bound to a native PWM pin";
+                  return 400;
+              }
+              inputAnalogBindings[it - inputAnalogPins.begin()] = pwmPin;
+          }
+      }
+
+      // Optional calibration per servo pin, as {"servoPin": {"minUs", "maxUs", "speed"}}.
+      // Servos without one keep their current calibration, new servos get the default.
+      inputServoCalibrations.assign(inputServoPins.size(), ServoCalibration{0, 0, 0});
+      if (root.containsKey("servoCalibrations")) {
+          for (JsonPair kv : root["servoCalibrations"].as<JsonObject>()) {
+              int servoPin = String(kv.key().c_str()).toInt();
+              auto it = std::find(inputServoPins.begin(), inputServoPins.end(), servoPin);
+              if (it == inputServoPins.end()) {
+                  response["error"] = "Calibration for pin " + String(servoPin) + " which is not a servo pin";
+                  return 400;
+              }
+              JsonObject calibrationObj = kv.value().as<JsonObject>();
+              ServoCalibration calibration = {calibrationObj["minUs"] | defaultServoCalibration.minUs,
+                                              calibrationObj["maxUs"] | defaultServoCalibration.maxUs,
+                                              calibrationObj["speed"] | defaultServoCalibration.speed};
+              if (calibration.minUs < ServoManager::SERVO_MIN_PULSE_US || calibration.minUs > ServoManager::SERVO_MAX_PULSE_US ||
+                  calibration.maxUs < ServoManager::SERVO_MIN_PULSE_US || calibration.maxUs > ServoManager::SERVO_MAX_PULSE_US) {
+                  response["error"] = "Servo pulse widths must be between " + String(ServoManager::SERVO_MIN_PULSE_US) +
+                                      " and " + String(ServoManager::SERVO_MAX_PULSE_US) + " us";
+                  return 400;
+              }
+              if (calibration.speed < 0 || calibration.speed > ServoManager::SERVO_MAX_SPEED) {
+                  response["error"] = "Servo speed must be between 0 and " + String(ServoManager::SERVO_MAX_SPEED);
+                  return 400;
+              }
+              inputServoCalibrations[it - inputServoPins.begin()] = calibration;
+          }
+      }
+
+      // Native PWM pins and servos each need an LEDC channel, expander pins do not
+      size_t nativePwmCount = std::count_if(inputPwmPins.begin(), inputPwmPins.end(),
+                                            [](int pin) { return !ExpanderManager::isVirtualPin(pin); });
+      if (nativePwmCount + inputServoPins.size() > ServoManager::LEDC_CHANNELS) {
+          response["error"] = "pwmPins and servoPins share " + String(ServoManager::LEDC_CHANNELS) + " LEDC channels";
+          return 400;
+      }
+
+      std::vector<const std::vector<int>*> roleLists = {&inputDigitalPins, &inputPwmPins, &inputFastLedPins, &inputAnalogPins,
+                                                        &inputServoPins, &inputSensorPins};
+
+      // Check for pins listed twice, in one list or across lists. A repeated pin would
+      // attach its output twice and give two strips the same LED buffer.
+      std::vector<int> duplicates;
+      for (size_t i = 0; i < roleLists.size(); ++i) {
+          const std::vector<int>& pins = *roleLists[i];
+          for (size_t k = 0; k < pins.size(); ++k) {
+              bool repeated = std::find(pins.begin() + k + 1, pins.end(), pins[k]) != pins.end();
+              for (size_t j = i + 1; !repeated && j < roleLists.size(); ++j) {
+                  repeated = containsPin(*roleLists[j], pins[k]);
+              }
+              if (repeated && !containsPin(duplicates, pins[k])) {
+                  duplicates.push_back(pins[k]);
+              }
           }
       }
 
       if (!duplicates.empty()) {
-          DynamicJsonDocument errorDoc(1024);
-          errorDoc["error"] = "Pins in multiple lists";
-          JsonArray duplicatePins = errorDoc.createNestedArray("duplicates");
+          response["error"] = "Pins listed more than once";
+          JsonArray duplicatePins = response.createNestedArray("duplicates");
           for (int pin : duplicates) {
               duplicatePins.add(pin);
           }
-          errorDoc["input"] = root;
-          String errorResponse;
-          serializeJson(errorDoc, errorResponse);
-          return errorResponse;
+          response["input"] = root;
+          return 400;
       }
 
       // Validate pins against availablePins and reservedPins
       std::vector<int> invalidPins;
       std::vector<int> reservedConflictPins;
 
-      for (int pin : inputDigitalPins) {
-          if (std::find(reservedPins.begin(), reservedPins.end(), pin) != reservedPins.end()) {
-              reservedConflictPins.push_back(pin);
-          } else if (std::find(availablePins.begin(), availablePins.end(), pin) == availablePins.end()) {
-              invalidPins.push_back(pin);
+      for (const std::vector<int>* roleList : roleLists) {
+          for (int pin : *roleList) {
+              if (std::find(reservedPins.begin(), reservedPins.end(), pin) != reservedPins.end()) {
+                  reservedConflictPins.push_back(pin);
+              } else if (std::find(availablePins.begin(), availablePins.end(), pin) == availablePins.end()) {
+                  invalidPins.push_back(pin);
+              }
           }
       }
 
-      for (int pin : inputPwmPins) {
-          if (std::find(reservedPins.begin(), reservedPins.end(), pin) != reservedPins.end()) {
-              reservedConflictPins.push_back(pin);
-          } else if (std::find(availablePins.begin(), availablePins.end(), pin) == availablePins.end()) {
+      // Analog inputs also need an ADC channel
+      for (int pin : inputAnalogPins) {
+          if (!containsPin(adcPins, pin) && !containsPin(invalidPins, pin) && !containsPin(reservedConflictPins, pin)) {
               invalidPins.push_back(pin);
           }
       }
 
-      for (int pin : inputFastLedPins) {
-          if (std::find(reservedPins.begin(), reservedPins.end(), pin) != reservedPins.end()) {
-              reservedConflictPins.push_back(pin);
-          } else if (std::find(availablePins.begin(), availablePins.end(), pin) == availablePins.end()) {
+      // Expander pins are outputs only: digital, and PWM on chips that have it
+      for (const std::vector<int>* roleList : {&inputFastLedPins, &inputAnalogPins, &inputServoPins, &inputSensorPins}) {
+          for (int pin : *roleList) {
+              if (ExpanderManager::isVirtualPin(pin) && !containsPin(invalidPins, pin)) {
+                  invalidPins.push_back(pin);
+              }
+          }
+      }
+      for (int pin : inputPwmPins) {
+          if (ExpanderManager::isVirtualPin(pin) && !ExpanderManager::supportsPwm(pin) && !containsPin(invalidPins, pin)) {
               invalidPins.push_back(pin);
           }
       }
 
       if (!invalidPins.empty() || !reservedConflictPins.empty()) {
-          DynamicJsonDocument errorDoc(1024);
-          errorDoc["error"] = "Pin validation failed";
+          response["error"] = "Pin validation failed";
 
-          JsonArray invalidArray = errorDoc.createNestedArray("invalidPins");
+          JsonArray invalidArray = response.createNestedArray("invalidPins");
           for (int pin : invalidPins) {
               invalidArray.add(pin);
           }
 
-          JsonArray reservedArray = errorDoc.createNestedArray("reservedConflictPins");
+          JsonArray reservedArray = response.createNestedArray("reservedConflictPins");
           for (int pin : reservedConflictPins) {
               reservedArray.add(pin);
           }
 
-          JsonArray availableArray = errorDoc.createNestedArray("availablePins");
+          JsonArray availableArray = response.createNestedArray("availablePins");
           for (int pin : availablePins) {
               availableArray.add(pin);
           }
 
-          JsonArray reservedPinsArray = errorDoc.createNestedArray("reservedPins");
+          JsonArray reservedPinsArray = response.createNestedArray("reservedPins");
           for (int pin : reservedPins) {
               reservedPinsArray.add(pin);
           }
-
-          String errorResponse;
-          serializeJson(errorDoc, errorResponse);
-          return errorResponse;
+          return 400;
       }
 
-      // Assign valid pins to corresponding lists
-      digitalPins = inputDigitalPins;
-      pwmPins = inputPwmPins;
-      fastLedPins = inputFastLedPins;
+      // Hand the new designation to the control task
+      PinDesignation* designation = new PinDesignation{inputDigitalPins, inputPwmPins, inputFastLedPins, inputNumLeds,
+                                                       inputAnalogPins, inputAnalogBindings, inputServoPins,
+                                                       inputServoCalibrations, inputSensorPins};
 
       // Sort the lists for consistency
-      std::sort(digitalPins.begin(), digitalPins.end());
-      std::sort(pwmPins.begin(), pwmPins.end());
-      std::sort(fastLedPins.begin(), fastLedPins.end());
+      std::vector<std::string> unusedTypes;
+      std::sort(designation->digitalPins.begin(), designation->digitalPins.end());
+      std::sort(designation->pwmPins.begin(), designation->pwmPins.end());
+      sortFastLedConfig(designation->fastLedPins, designation->numLeds, unusedTypes);
+      sortAnalogConfig(designation->analogPins, designation->analogBindings);
+      sortServoConfig(designation->servoPins, designation->servoCalibrations);
+      std::sort(designation->sensorPins.begin(), designation->sensorPins.end());
+
+      ControlTask::Command command = {};
+      command.type = ControlTask::APPLY_DESIGNATION;
+      command.designation = designation;
+      if (!ControlTask::submit(command)) {
+          delete designation;
+          response["error"] = "Command queue full";
+          return 503;
+      }
+      
+      LOG_DEBUG(PIN_DESIGNATION_QUEUED);
+      response["message"] = "Pin designation updated successfully";
+      return 200;
+  }
+
+
+  // Apply a new designation by diffing it against the current one.
+  // Only pins that change role are detached or attached, unchanged outputs keep
+  // their value, and LED buffers are reused, resized or freed as needed.
+  void applyPinDesignation(const PinDesignation& designation) {
+      // Hardware and buffers are set up without stateMutex, so web readers never wait on
+      // pin I/O. They see the old designation until the lists are swapped at the end.
+      size_t detached = 0, attached = 0, resized = 0;
+
+      // Release outputs that lose their role
+      for (int pin : pwmPins) {
+          if (!containsPin(designation.pwmPins, pin)) {
+              detachPwmOutput(pin);
+              detached++;
+          }
+      }
+      for (int pin : digitalPins) {
+          if (!containsPin(designation.digitalPins, pin)) {
+              writeDigitalOutput(pin, LOW);
+              detached++;
+          }
+      }
+      for (size_t i = 0; i < fastLedPins.size(); ++i) {
+          if (!containsPin(designation.fastLedPins, fastLedPins[i])) {
+              detachStrip(fastLedPins[i], numLeds[i]);
+          }
+      }
+
+      // Rebuild the FastLED buffers, old ones are freed after the swap as readers may still use them.
+      // The frame buffers go through the same rebuild, so they stay aligned with the strips.
+      StripBuffers::Rebuild<CRGB> strips = StripBuffers::rebuild(fastLedPins, fastLeds, numLeds, fastLedType,
+                                                                 designation.fastLedPins, designation.numLeds,
+                                                                 defaultNumLeds, defaultFastLedType);
+      StripBuffers::Rebuild<CRGB> frames = StripBuffers::rebuild(fastLedPins, ledFrames, numLeds, fastLedType,
+                                                                 designation.fastLedPins, designation.numLeds,
+                                                                 defaultNumLeds, defaultFastLedType);
+      attached += strips.attached;
+      detached += strips.detached;
+      resized += strips.resized;
+
+      // Restart ADC sampling before any freed pin is attached as an output
+      ThrottleManager::configure(designation.analogPins, designation.analogBindings);
+
+      // Sensors likewise release their interrupts first, new ones start at their current level
+      RulesManager::configureSensors(designation.sensorPins);
+
+      // Servos release their LEDC channels before new PWM pins claim them
+      std::vector<ServoCalibration> newCalibrations = designation.servoCalibrations;
+      for (size_t i = 0; i < designation.servoPins.size() && i < newCalibrations.size(); ++i) {
+          if (newCalibrations[i].minUs == 0) {
+              auto it = std::find(servoPins.begin(), servoPins.end(), designation.servoPins[i]);
+              bool known = it != servoPins.end() && size_t(it - servoPins.begin()) < servoCalibrations.size();
+              newCalibrations[i] = known ? servoCalibrations[it - servoPins.begin()] : defaultServoCalibration;
+          }
+      }
+      std::vector<int> newServoPins = designation.servoPins;
+      std::vector<int> newFailedPins = ServoManager::configure(newServoPins, newCalibrations);
+      dropFailedPins(newServoPins, &newCalibrations, newFailedPins);
+
+      // Configure outputs that gained their role
+      std::vector<int> newPwmPins = designation.pwmPins;
+      for (int pin : designation.pwmPins) {
+          if (!containsPin(pwmPins, pin)) {
+              if (attachPwmOutput(pin)) {
+                  attached++;
+              } else {
+                  newFailedPins.push_back(pin);
+              }
+          }
+      }
+      dropFailedPins(newPwmPins, nullptr, newFailedPins);
+      for (int pin : designation.digitalPins) {
+          if (!containsPin(digitalPins, pin)) {
+              attachDigitalOutput(pin);
+              attached++;
+          }
+      }
+
+      // Publish the new designation
+      std::vector<int> newDigitalValues = carryValues(digitalPins, digitalValues, designation.digitalPins);
+      std::vector<int> newPwmDuties = carryValues(pwmPins, pwmDuties, newPwmPins);
+      {
+          std::lock_guard<std::mutex> lock(stateMutex);
+          digitalPins = designation.digitalPins;
+          digitalValues.swap(newDigitalValues);
+          pwmPins.swap(newPwmPins);
+          pwmDuties.swap(newPwmDuties);
+          fastLedPins = designation.fastLedPins;
+          fastLeds.swap(strips.leds);
+          numLeds.swap(strips.counts);
+          fastLedType.swap(strips.types);
+          analogPins = designation.analogPins;
+          analogBindings = designation.analogBindings;
+          sensorPins = designation.sensorPins;
+          servoPins.swap(newServoPins);
+          servoCalibrations.swap(newCalibrations);
+          failedPins.swap(newFailedPins);
+      }
 
-      // Reinitialize the pins
-      initializePins();  // This ensures the new pins are properly configured
+      // Point the controllers at the new frames before the old ones are freed
+      ledFrames.swap(frames.leds);
+      for (size_t i = 0; i < fastLedPins.size(); ++i) {
+          attachStrip(fastLedPins[i], ledFrames[i], numLeds[i]);
+      }
+      StripBuffers::release(strips.retired);
+      StripBuffers::release(frames.retired);
+      updateLedFrameInterval();
       
-      Serial.println("Pin designation updated.");
-      AddToLog("Pin designation updated.");
-      return R"({"message":"Pin designation updated successfully"})";
+      LOG_INFO(PIN_DESIGNATION_UPDATED, attached, detached, resized);
   }
 
 
-  String getPinValues() {
-      DynamicJsonDocument doc(1024);
+  // Reports the values the control task last wrote, the pins themselves are not read
+  void getPinValues(JsonDocument& doc) {
+      std::unique_lock<std::mutex> lock(stateMutex);
       JsonObject root = doc.to<JsonObject>();
 
       // Get digital pin values
       JsonObject digitalObj = root.createNestedObject("digitalPins");
-      for (int pin : digitalPins) {
-          digitalObj[String(pin)] = digitalRead(pin);
+      for (size_t i = 0; i < digitalPins.size() && i < digitalValues.size(); ++i) {
+          digitalObj[String(digitalPins[i])] = digitalValues[i];
       }
 
-      // Get PWM pin values
+      // Get PWM pin values, duty 0-255
       JsonObject pwmObj = root.createNestedObject("pwmPins");
-      for (int pin : pwmPins) {
-          pwmObj[String(pin)] = ledcRead(pin);
+      for (size_t i = 0; i < pwmPins.size() && i < pwmDuties.size(); ++i) {
+          pwmObj[String(pwmPins[i])] = pwmDuties[i];
       }
 
       // Get FastLED values
@@ -306,28 +824,47 @@ namespace PinManager {
           colorArray.add(fastLeds[i]->g);
           colorArray.add(fastLeds[i]->b);
       }
+      lock.unlock(); // The managers below take their own locks, ThrottleManager::poll publishes under ours
+
+
+      // Analog throttle inputs and who is driving their output
+      JsonObject analogObj = root.createNestedObject("analogPins");
+      ThrottleManager::describe(analogObj);
 
-      String jsonResponse;
-      serializeJson(doc, jsonResponse);
-      return jsonResponse;
+      // Servo positions, they move towards their target at their own speed
+      JsonObject servoObj = root.createNestedObject("servoPins");
+      ServoManager::describe(servoObj);
+
+      // Sensor levels, as last debounced
+      JsonObject sensorObj = root.createNestedObject("sensorPins");
+      RulesManager::describeSensors(sensorObj);
+
+      // I2C expanders and how much bus traffic the batched writes took
+      JsonArray expanderArray = root.createNestedArray("expanders");
+      ExpanderManager::describe(expanderArray);
+
+      // Estimated LED supply current and the brightness scale applied to stay in budget
+      JsonObject powerObj = root.createNestedObject("ledPower");
+      powerObj["requestedMa"] = ledRequestedMa.load();
+      powerObj["budgetMa"] = ledPowerBudgetMa;
+      powerObj["scalePercent"] = ledScaleQ16.load() * 100 / LedPipeline::SCALE_ONE;
   }
 
 
-  String postPinValues(const String& body) {
-      Serial.println("postPinValues started");
-      DynamicJsonDocument doc(1024);
-      DeserializationError error = deserializeJson(doc, body);
-      
-      if (error) {
-          return R"({"error":"Invalid JSON", "details":")" + String(error.c_str()) + R"("})";
-      }
+  void postPinValues(JsonDocument& doc, JsonDocument& response) {
+      LOG_DEBUG(PIN_VALUES_STARTED);
 
       JsonObject root = doc.as<JsonObject>();
       JsonObject digitalValues = root["digital"].as<JsonObject>();
       JsonObject pwmValues = root["pwm"].as<JsonObject>();
       JsonObject fastLedValues = root["fastLed"].as<JsonObject>();
+      JsonObject servoValues = root["servo"].as<JsonObject>();
 
       std::vector<String> errors;
+      std::vector<ControlTask::Command> commands;
+
+      // Validate against the current designation, the control task applies the writes
+      std::unique_lock<std::mutex> lock(stateMutex);
 
       // Validate digital pins
       for (JsonPair kv : digitalValues) {
@@ -339,7 +876,11 @@ namespace PinManager {
           } else if (value < 0 || value > 1) {
               errors.push_back("Digital pin " + String(pin) + " must be 0 or 1");
           } else {
-              digitalWrite(pin, value);
+              ControlTask::Command command = {};
+              command.type = ControlTask::SET_DIGITAL;
+              command.pin = pin;
+              command.value = value;
+              commands.push_back(command);
           }
       }
 
@@ -353,7 +894,11 @@ namespace PinManager {
           } else if (value < 0 || value > 100) {
               errors.push_back("PWM pin " + String(pin) + " must be between 0 and 100");
           } else {
-              ledcWrite(pin, map(value, 0, 100, 0, 255));
+              ControlTask::Command command = {};
+              command.type = ControlTask::SET_PWM;
+              command.pin = pin;
+              command.value = value;
+              commands.push_back(command);
           }
       }
 
@@ -371,26 +916,143 @@ namespace PinManager {
           } else if (r < 0 || r > 255 || g < 0 || g > 255 || b < 0 || b > 255) {
               errors.push_back("FastLED pin " + String(pin) + " values (r, g, b) must be between 0 and 255");
           } else {
-              fill_solid(fastLeds[pin], numLeds[pin], CRGB(r, g, b));
+              ControlTask::Command command = {};
+              command.type = ControlTask::SET_FASTLED;
+              command.pin = pin;
+              command.r = r;
+              command.g = g;
+              command.b = b;
+              commands.push_back(command);
           }
       }
 
-      FastLED.show();
+      // Validate servo targets, 0-100 between the calibrated endpoints
+      for (JsonPair kv : servoValues) {
+          int pin = String(kv.key().c_str()).toInt();
+          int value = kv.value().as<int>();
+
+          if (std::find(servoPins.begin(), servoPins.end(), pin) == servoPins.end()) {
+              errors.push_back("Pin " + String(pin) + " is not designated as servo");
+          } else if (value < 0 || value > 100) {
+              errors.push_back("Servo pin " + String(pin) + " must be between 0 and 100");
+          } else {
+              ControlTask::Command command = {};
+              command.type = ControlTask::SET_SERVO;
+              command.pin = pin;
+              command.value = value;
+              commands.push_back(command);
+          }
+      }
+      lock.unlock();
+
+      // All valid writes are queued together, or none are
+      if (commands.size() > ControlTask::COMMAND_QUEUE_SIZE) {
+          errors.push_back("At most " + String(ControlTask::COMMAND_QUEUE_SIZE) + " values per request, no pins updated");
+      } else if (!ControlTask::submitAll(commands.data(), commands.size())) {
+          errors.push_back("Command queue full, no pins updated");
+      }
 
       // Return errors if any
       if (!errors.empty()) {
-          DynamicJsonDocument errorDoc(1024);
-          JsonArray errorArray = errorDoc.createNestedArray("errors");
+          JsonArray errorArray = response.createNestedArray("errors");
           for (const String& err : errors) {
               errorArray.add(err);
           }
-          String errorResponse;
-          serializeJson(errorDoc, errorResponse);
-          return errorResponse;
+          return;
       }
       
-      Serial.println("Pin values updated");
-      return R"({"message":"Pin values updated successfully"})";
+      LOG_DEBUG(PIN_VALUES_UPDATED);
+      response["message"] = "Pin values updated successfully";
+  }
+
+
+  PinRole pinRole(int pin) {
+      std::lock_guard<std::mutex> lock(stateMutex);
+      if (containsPin(digitalPins, pin)) return ROLE_DIGITAL;
+      if (containsPin(pwmPins, pin)) return ROLE_PWM;
+      if (containsPin(fastLedPins, pin)) return ROLE_FASTLED;
+      if (containsPin(analogPins, pin)) return ROLE_ANALOG;
+      if (containsPin(servoPins, pin)) return ROLE_SERVO;
+      if (containsPin(sensorPins, pin)) return ROLE_SENSOR;
+      return ROLE_NONE;
+  }
+
+
+  // The designation may have changed since the command was validated. Only this task
+  // changes it, so the lists are read without the lock and the pin keeps its role until the write.
+  void applyDigitalValue(int pin, int value) {
+      if (std::find(digitalPins.begin(), digitalPins.end(), pin) != digitalPins.end()) {
+          writeDigitalOutput(pin, value);
+          publishValue(digitalPins, digitalValues, pin, value);
+      }
+  }
+
+
+  void applyPwmValue(int pin, int value) {
+      if (std::find(pwmPins.begin(), pwmPins.end(), pin) != pwmPins.end()) {
+          ThrottleManager::noteRemoteWrite(pin); // The remote wins until the knob is moved
+          writePwmOutput(pin, value);
+          publishValue(pwmPins, pwmDuties, pin, map(value, 0, 100, 0, 255));
+      }
+  }
+
+
+  void publishPwmDuty(int pin, int duty) {
+      publishValue(pwmPins, pwmDuties, pin, duty);
+  }
+
+
+  // Takes the lock because getPinValues reads the colors
+  bool applyFastLedColor(int pin, const CRGB& color) {
+      std::lock_guard<std::mutex> lock(stateMutex);
+      auto it = std::find(fastLedPins.begin(), fastLedPins.end(), pin);
+      if (it == fastLedPins.end()) {
+          return false;
+      }
+      size_t index = it - fastLedPins.begin();
+      if (index >= fastLeds.size() || index >= numLeds.size()) {
+          return false;
+      }
+      fill_solid(fastLeds[index], numLeds[index], color);
+      return true;
+  }
+
+
+  uint32_t ledFrameInterval() {
+      return ledFrameMs;
+  }
+
+
+  // Output one frame: estimate the draw of every strip, scale to the shared budget,
+  // then gamma correct and dither into ledFrames. Runs on the control task.
+  bool renderLedFrame(uint8_t frame) {
+      if (fastLeds.empty()) {
+          ledRequestedMa = 0;
+          return false;
+      }
+
+      uint64_t gammaTotal = 0;
+      size_t ledCount = 0;
+      for (size_t i = 0; i < fastLeds.size(); ++i) {
+          gammaTotal += LedPipeline::gammaSum(reinterpret_cast<const uint8_t*>(fastLeds[i]), numLeds[i] * 3);
+          ledCount += numLeds[i];
+      }
+
+      LedPipeline::PowerBudget budget = {ledPowerBudgetMa, ledMaPerChannel, ledIdleMaPerLed};
+      LedPipeline::FrameStats stats = LedPipeline::budgetScale(gammaTotal, ledCount, budget);
+      // Too slow a frame rate for temporal dithering, hold one frame
+      bool temporal = ledFrameMs <= ControlTask::LED_DITHER_MAX_MS;
+      bool dithering = false;
+      for (size_t i = 0; i < fastLeds.size(); ++i) {
+          dithering |= LedPipeline::renderStrip(reinterpret_cast<const uint8_t*>(fastLeds[i]),
+                                                reinterpret_cast<uint8_t*>(ledFrames[i]), numLeds[i] * 3,
+                                                stats.scaleQ16, temporal ? frame : 0);
+      }
+      ledRequestedMa = stats.requestedMa;
+      ledScaleQ16 = stats.scaleQ16;
+
+      FastLED.show();
+      return temporal && dithering;
   }
 
 }
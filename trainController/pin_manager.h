@@ -3,20 +3,60 @@
 #define PIN_MANAGER_H
 
 #include <FastLED.h>
+#include <ArduinoJson.h>
 #include <vector>
 #include <string>
 #include "input_config.h"
 
 namespace PinManager {
 	extern std::vector<CRGB*> fastLeds;
+
+	// A requested pin designation, validated by postPinDesignation
+	struct PinDesignation {
+		std::vector<int> digitalPins;
+		std::vector<int> pwmPins;
+		std::vector<int> fastLedPins;
+		std::vector<int> numLeds; // Per fastLed pin, 0 keeps the current count
+		std::vector<int> analogPins;
+		std::vector<int> analogBindings; // Per analog pin, -1 for none
+		std::vector<int> servoPins;
+		std::vector<ServoCalibration> servoCalibrations; // Per servo pin, minUs 0 keeps the current one
+		std::vector<int> sensorPins;
+	};
+
+	enum PinRole : uint8_t {
+		ROLE_NONE,
+		ROLE_DIGITAL,
+		ROLE_PWM,
+		ROLE_FASTLED,
+		ROLE_ANALOG,
+		ROLE_SERVO,
+		ROLE_SENSOR
+	};
 	
 	void initializePins();
   void cleanupFastLED();
   void resetPins();
-  String getPinDesignation();
-  String postPinDesignation(const String &body);
-  String getPinValues();
-  String postPinValues(const String &body);
+  // REST handlers, the body is already parsed and the reply is built in response
+  void getPinDesignation(JsonDocument& response);
+  int postPinDesignation(JsonDocument& body, JsonDocument& response); // HTTP status
+  void getPinValues(JsonDocument& response);
+  void postPinValues(JsonDocument& body, JsonDocument& response);
+  // Response capacities of the two GETs for the current pin counts, expander pins included
+  size_t pinDesignationCapacity();
+  size_t pinValuesCapacity();
+
+  // Role of a pin in the current designation, from any task
+  PinRole pinRole(int pin);
+
+  // Applied on the control task only
+  void applyDigitalValue(int pin, int value);
+  void applyPwmValue(int pin, int value);
+  void publishPwmDuty(int pin, int duty); // For PWM pins driven directly, e.g. by a throttle
+  bool applyFastLedColor(int pin, const CRGB& color);
+  void applyPinDesignation(const PinDesignation& designation);
+  bool renderLedFrame(uint8_t frame); // True while dithering needs further frames
+  uint32_t ledFrameInterval();         // For the current strips, see ControlTask::LED_FRAME_MS
 }
 
 #endif
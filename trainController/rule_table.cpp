@@ -0,0 +1,65 @@
+// rule_table.cpp
+#include "rule_table.h"
+
+
+bool RuleTable::add(uint8_t source, Edge edge, const RuleAction* actions, size_t count) {
+    if (source >= MAX_SOURCES || ruleList.size() >= MAX_RULES || ruleActions.size() + count > MAX_ACTIONS) {
+        return false;
+    }
+    ruleList.push_back({source, edge, static_cast<uint16_t>(ruleActions.size()), static_cast<uint16_t>(count)});
+    ruleActions.insert(ruleActions.end(), actions, actions + count);
+    return true;
+}
+
+
+void RuleTable::clear() {
+    ruleList.clear();
+    ruleActions.clear();
+    table.clear();
+    for (size_t i = 0; i <= SLOTS; ++i) {
+        slotStart[i] = 0;
+    }
+}
+
+
+// Counting sort of the actions by slot, stable so upload order is kept within a slot
+void RuleTable::compile() {
+    uint16_t counts[SLOTS] = {};
+    for (const Rule& rule : ruleList) {
+        if (rule.edge != FALLING) counts[rule.source * 2] += rule.actionCount;
+        if (rule.edge != RISING) counts[rule.source * 2 + 1] += rule.actionCount;
+    }
+
+    slotStart[0] = 0;
+    for (size_t i = 0; i < SLOTS; ++i) {
+        slotStart[i + 1] = slotStart[i] + counts[i];
+    }
+    table.assign(slotStart[SLOTS], RuleAction{});
+
+    uint16_t fill[SLOTS];
+    for (size_t i = 0; i < SLOTS; ++i) {
+        fill[i] = slotStart[i];
+    }
+    for (const Rule& rule : ruleList) {
+        const RuleAction* actions = ruleActions.data() + rule.firstAction;
+        for (size_t slot : {size_t(rule.source * 2), size_t(rule.source * 2 + 1)}) {
+            bool rising = slot % 2 == 0;
+            if ((rising && rule.edge == FALLING) || (!rising && rule.edge == RISING)) {
+                continue;
+            }
+            for (size_t i = 0; i < rule.actionCount; ++i) {
+                table[fill[slot]++] = actions[i];
+            }
+        }
+    }
+}
+
+
+RuleTable::Span RuleTable::actionsFor(uint8_t source, bool rising) const {
+    if (source >= MAX_SOURCES || table.empty()) {
+        return {nullptr, nullptr};
+    }
+    size_t slot = source * 2 + (rising ? 0 : 1);
+    const RuleAction* base = table.data();
+    return {base + slotStart[slot], base + slotStart[slot + 1]};
+}
@@ -0,0 +1,69 @@
+// rule_table.h
+#ifndef RULE_TABLE_H
+#define RULE_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One output write done by a rule
+struct RuleAction {
+    enum Type : uint8_t { DIGITAL, PWM, SERVO, FASTLED };
+    Type type;
+    int16_t pin;
+    int32_t value; // Level, percent, servo position or 0xRRGGBB
+};
+
+
+// Event to action rules. Rules are kept in upload order for reporting, compile()
+// copies their actions into one array grouped per (source, edge) slot. Finding the
+// actions for an event is then an index lookup and a contiguous scan, with no
+// parsing or allocation. Within a slot actions run in upload order, so a later
+// rule wins when two write the same pin. No Arduino dependency.
+class RuleTable {
+public:
+    enum Edge : uint8_t { RISING, FALLING, CHANGE };
+
+    struct Rule {
+        uint8_t source; // Sensor pin
+        Edge edge;
+        uint16_t firstAction; // Into actions()
+        uint16_t actionCount;
+    };
+
+    struct Span {
+        const RuleAction* first;
+        const RuleAction* last;
+        const RuleAction* begin() const { return first; }
+        const RuleAction* end() const { return last; }
+        size_t size() const { return last - first; }
+    };
+
+    static const size_t MAX_SOURCES = 32; // Native GPIO numbers
+    static const size_t MAX_RULES = 512;
+    static const size_t MAX_ACTIONS = 2048;
+
+    // False when the table is full or the source is out of range
+    bool add(uint8_t source, Edge edge, const RuleAction* actions, size_t count);
+    void clear();
+
+    // Build the dispatch table, after the last add()
+    void compile();
+
+    // Actions for an event, empty until compiled
+    Span actionsFor(uint8_t source, bool rising) const;
+
+    const std::vector<Rule>& rules() const { return ruleList; }
+    const std::vector<RuleAction>& actions() const { return ruleActions; }
+    size_t compiledSize() const { return table.size(); } // A CHANGE rule counts twice
+
+private:
+    static const size_t SLOTS = MAX_SOURCES * 2; // Rising and falling per source
+
+    std::vector<Rule> ruleList;
+    std::vector<RuleAction> ruleActions;
+    uint16_t slotStart[SLOTS + 1] = {}; // Slot s is table[slotStart[s]] up to table[slotStart[s + 1]]
+    std::vector<RuleAction> table;
+};
+
+#endif
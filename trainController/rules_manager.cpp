@@ -0,0 +1,344 @@
+// rules_manager.cpp
+#include "rules_manager.h"
+#include "control_task.h"
+#include "input_config.h"
+#include "log_manager.h"
+#include "pin_manager.h"
+#include "servo_manager.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+
+namespace RulesManager {
+
+    struct Sensor {
+        int pin;
+        int level;
+        uint32_t lastEdgeMs;
+    };
+
+    struct Event {
+        uint8_t pin;
+        bool rising;
+        uint32_t edgeUs;
+    };
+
+    const char* const edgeNames[] = {"rising", "falling", "change"};
+    const char* const actionNames[] = {"digital", "pwm", "servo", "fastLed"};
+
+    // Control task
+    std::vector<Sensor> sensors;
+    std::mutex sensorMutex; // describeSensors() reads levels from the web server task
+    RuleTable* active = nullptr;
+    volatile uint32_t edgeUs[RuleTable::MAX_SOURCES]; // Last pin change seen by the interrupt
+
+    // Web server task, the rules as last accepted. Appends build on these.
+    RuleTable accepted;
+
+    std::atomic<uint32_t> eventCount(0);
+    std::atomic<uint32_t> actionCount(0);
+    std::atomic<uint32_t> lastReactionUs(0);
+    std::atomic<uint32_t> maxReactionUs(0);
+
+
+    void ARDUINO_ISR_ATTR sensorIsr(void* arg) {
+        edgeUs[reinterpret_cast<uintptr_t>(arg)] = micros();
+        ControlTask::notifyFromIsr();
+    }
+
+
+    void configureSensors(const std::vector<int>& pins) {
+        std::lock_guard<std::mutex> lock(sensorMutex);
+
+        for (const Sensor& sensor : sensors) {
+            if (std::find(pins.begin(), pins.end(), sensor.pin) == pins.end()) {
+                detachInterrupt(sensor.pin);
+            }
+        }
+
+        std::vector<Sensor> updated;
+        for (int pin : pins) {
+            if (pin < 0 || pin >= (int)RuleTable::MAX_SOURCES) {
+                continue;
+            }
+            auto it = std::find_if(sensors.begin(), sensors.end(), [&](const Sensor& sensor) { return sensor.pin == pin; });
+            if (it != sensors.end()) {
+                updated.push_back(*it);
+                continue;
+            }
+            // New sensors start at their current level, without firing a rule
+            pinMode(pin, INPUT_PULLUP);
+            attachInterruptArg(pin, sensorIsr, reinterpret_cast<void*>(static_cast<uintptr_t>(pin)), CHANGE);
+            updated.push_back({pin, digitalRead(pin), millis()});
+        }
+        sensors.swap(updated);
+
+        LOG_INFO(SENSORS_CONFIGURED, sensors.size());
+    }
+
+
+    void install(RuleTable* table) {
+        delete active;
+        active = table;
+        LOG_INFO(RULES_INSTALLED, active->rules().size(), active->compiledSize());
+    }
+
+
+    void apply(const RuleAction& action, bool& ledsDirty) {
+        switch (action.type) {
+            case RuleAction::DIGITAL:
+                PinManager::applyDigitalValue(action.pin, action.value);
+                break;
+            case RuleAction::PWM:
+                PinManager::applyPwmValue(action.pin, action.value);
+                break;
+            case RuleAction::SERVO:
+                ServoManager::setTarget(action.pin, action.value);
+                break;
+            case RuleAction::FASTLED:
+                ledsDirty |= PinManager::applyFastLedColor(action.pin, CRGB(uint8_t(action.value >> 16), uint8_t(action.value >> 8), uint8_t(action.value)));
+                break;
+        }
+    }
+
+
+    bool poll(uint32_t nowMs) {
+        Event events[RuleTable::MAX_SOURCES];
+        size_t count = 0;
+
+        // Collect the edges first, actions take stateMutex which ranks before sensorMutex
+        {
+            std::lock_guard<std::mutex> lock(sensorMutex);
+            for (Sensor& sensor : sensors) {
+                int level = digitalRead(sensor.pin);
+                if (level == sensor.level || nowMs - sensor.lastEdgeMs < sensorDebounceMs) {
+                    continue;
+                }
+                sensor.level = level;
+                sensor.lastEdgeMs = nowMs;
+                events[count++] = {static_cast<uint8_t>(sensor.pin), level == HIGH, edgeUs[sensor.pin]};
+            }
+        }
+        if (count == 0 || active == nullptr) {
+            return false;
+        }
+
+        bool ledsDirty = false;
+        for (size_t i = 0; i < count; ++i) {
+            RuleTable::Span actions = active->actionsFor(events[i].pin, events[i].rising);
+            for (const RuleAction& action : actions) {
+                apply(action, ledsDirty);
+            }
+
+            // From the pin change to the last output written, expander pins go out at the end of this tick
+            uint32_t reactionUs = micros() - events[i].edgeUs;
+            lastReactionUs = reactionUs;
+            if (reactionUs > maxReactionUs) {
+                maxReactionUs = reactionUs;
+            }
+            eventCount++;
+            actionCount += actions.size();
+        }
+        return ledsDirty;
+    }
+
+
+    void describeSensors(JsonObject& target) {
+        std::lock_guard<std::mutex> lock(sensorMutex);
+        for (const Sensor& sensor : sensors) {
+            target[String(sensor.pin)] = sensor.level;
+        }
+    }
+
+
+    // Document size of one rule in the GET /rules reply
+    size_t ruleCapacity(const RuleTable::Rule& rule, const std::vector<RuleAction>& actions) {
+        size_t size = JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(rule.actionCount);
+        for (size_t j = rule.firstAction; j < size_t(rule.firstAction + rule.actionCount); ++j) {
+            size += actions[j].type == RuleAction::FASTLED ? JSON_OBJECT_SIZE(5) : JSON_OBJECT_SIZE(3);
+        }
+        return size;
+    }
+
+
+    void getRules(JsonDocument& response, size_t offset) {
+        const std::vector<RuleTable::Rule>& rules = accepted.rules();
+        const std::vector<RuleAction>& actions = accepted.actions();
+
+        // The page is sized by its actions: rules are added while they fit the document
+        size_t used = JSON_OBJECT_SIZE(5) + JSON_OBJECT_SIZE(4) + JSON_ARRAY_SIZE(0);
+        size_t end = std::min(offset, rules.size());
+        while (end < rules.size()) {
+            size_t size = ruleCapacity(rules[end], actions) + JSON_ARRAY_SIZE(1);
+            if (used + size > response.capacity()) {
+                break;
+            }
+            used += size;
+            end++;
+        }
+
+        response["total"] = rules.size();
+        response["offset"] = offset;
+        if (end < rules.size()) {
+            response["next"] = end;
+        }
+        JsonArray ruleArray = response.createNestedArray("rules");
+        for (size_t i = offset; i < end; ++i) {
+            const RuleTable::Rule& rule = rules[i];
+            JsonObject ruleObj = ruleArray.createNestedObject();
+            ruleObj["pin"] = rule.source;
+            ruleObj["edge"] = edgeNames[rule.edge];
+
+            JsonArray actionArray = ruleObj.createNestedArray("actions");
+            for (size_t j = rule.firstAction; j < size_t(rule.firstAction + rule.actionCount); ++j) {
+                const RuleAction& action = actions[j];
+                JsonObject actionObj = actionArray.createNestedObject();
+                actionObj["type"] = actionNames[action.type];
+                actionObj["pin"] = action.pin;
+                if (action.type == RuleAction::FASTLED) {
+                    actionObj["r"] = (action.value >> 16) & 0xFF;
+                    actionObj["g"] = (action.value >> 8) & 0xFF;
+                    actionObj["b"] = action.value & 0xFF;
+                } else {
+                    actionObj["value"] = action.value;
+                }
+            }
+        }
+
+        JsonObject statsObj = response.createNestedObject("stats");
+        statsObj["events"] = eventCount.load();
+        statsObj["actions"] = actionCount.load();
+        statsObj["lastReactionUs"] = lastReactionUs.load();
+        statsObj["maxReactionUs"] = maxReactionUs.load();
+    }
+
+
+    // Check one action against the current designation, returns an error or an empty string
+    String parseAction(JsonObject actionObj, RuleAction& action) {
+        String type = actionObj["type"] | "";
+        int pin = actionObj["pin"] | -1;
+        PinManager::PinRole role = PinManager::pinRole(pin);
+        action.pin = pin;
+
+        if (type == "digital") {
+            action.type = RuleAction::DIGITAL;
+            action.value = actionObj["value"] | -1;
+            if (role != PinManager::ROLE_DIGITAL) return "pin " + String(pin) + " is not designated as digital";
+            if (action.value < 0 || action.value > 1) return "digital value must be 0 or 1";
+        } else if (type == "pwm") {
+            action.type = RuleAction::PWM;
+            action.value = actionObj["value"] | -1;
+            if (role != PinManager::ROLE_PWM) return "pin " + String(pin) + " is not designated as PWM";
+            if (action.value < 0 || action.value > 100) return "PWM value must be between 0 and 100";
+        } else if (type == "servo") {
+            action.type = RuleAction::SERVO;
+            action.value = actionObj["value"] | -1;
+            if (role != PinManager::ROLE_SERVO) return "pin " + String(pin) + " is not designated as servo";
+            if (action.value < 0 || action.value > 100) return "servo value must be between 0 and 100";
+        } else if (type == "fastLed") {
+            action.type = RuleAction::FASTLED;
+            int r = actionObj["r"] | -1;
+            int g = actionObj["g"] | -1;
+            int b = actionObj["b"] | -1;
+            if (role != PinManager::ROLE_FASTLED) return "pin " + String(pin) + " is not designated as FastLED";
+            if (r < 0 || r > 255 || g < 0 || g > 255 || b < 0 || b > 255) return "FastLED values (r, g, b) must be between 0 and 255";
+            action.value = (r << 16) | (g << 8) | b;
+        } else {
+            return "unknown action type '" + type.substring(0, 16) + "'"; // Client text, bounded
+        }
+        return String();
+    }
+
+
+    // Replace the rules, or add to them with "append": true so large sets can be sent in batches
+    int postRules(JsonDocument& body, JsonDocument& response) {
+        JsonObject root = body.as<JsonObject>();
+        if (!root["rules"].is<JsonArray>()) {
+            response["error"] = "Missing rules array";
+            return 400;
+        }
+
+        RuleTable updated;
+        if (root["append"] | false) {
+            updated = accepted;
+        }
+
+        std::vector<String> errors;
+        size_t index = 0;
+        for (JsonObject ruleObj : root["rules"].as<JsonArray>()) {
+            String prefix = "Rule " + String(index++) + ": ";
+            int pin = ruleObj["pin"] | -1;
+            String edgeName = ruleObj["edge"] | "";
+            JsonArray actionArray = ruleObj["actions"].as<JsonArray>();
+
+            RuleTable::Edge edge;
+            if (edgeName == "rising") {
+                edge = RuleTable::RISING;
+            } else if (edgeName == "falling") {
+                edge = RuleTable::FALLING;
+            } else if (edgeName == "change") {
+                edge = RuleTable::CHANGE;
+            } else {
+                errors.push_back(prefix + "edge must be rising, falling or change");
+                continue;
+            }
+            if (PinManager::pinRole(pin) != PinManager::ROLE_SENSOR) {
+                errors.push_back(prefix + "pin " + String(pin) + " is not designated as sensor");
+                continue;
+            }
+            if (actionArray.size() == 0 || actionArray.size() > MAX_ACTIONS_PER_RULE) {
+                errors.push_back(prefix + "needs 1 to " + String(MAX_ACTIONS_PER_RULE) + " actions");
+                continue;
+            }
+
+            RuleAction actions[MAX_ACTIONS_PER_RULE];
+            size_t count = 0;
+            for (JsonObject actionObj : actionArray) {
+                String error = parseAction(actionObj, actions[count]);
+                if (error.length() > 0) {
+                    errors.push_back(prefix + "action " + String(count) + ": " + error);
+                    break;
+                }
+                count++;
+            }
+            if (count < actionArray.size()) {
+                continue;
+            }
+
+            if (!updated.add(pin, edge, actions, count)) {
+                errors.push_back(prefix + "rule table full, at most " + String(RuleTable::MAX_RULES) + " rules and " +
+                                 String(RuleTable::MAX_ACTIONS) + " actions");
+                break;
+            }
+        }
+
+        // All or nothing, the running rules stay as they are. Only the first errors are
+        // listed, a large batch with the same mistake in every rule would not fit the reply.
+        if (!errors.empty()) {
+            response["error"] = "Rule validation failed";
+            response["errorCount"] = errors.size();
+            JsonArray errorArray = response.createNestedArray("errors");
+            for (size_t i = 0; i < errors.size() && i < MAX_REPORTED_ERRORS; ++i) {
+                errorArray.add(errors[i]);
+            }
+            return 400;
+        }
+
+        updated.compile();
+        ControlTask::Command command = {};
+        command.type = ControlTask::APPLY_RULES;
+        command.rules = new RuleTable(updated);
+        if (!ControlTask::submit(command)) {
+            delete command.rules;
+            response["error"] = "Command queue full";
+            return 503;
+        }
+
+        accepted = std::move(updated);
+        response["message"] = "Rules updated successfully";
+        response["rules"] = accepted.rules().size();
+        response["actions"] = accepted.actions().size();
+        return 200;
+    }
+}
@@ -0,0 +1,36 @@
+// rules_manager.h
+#ifndef RULES_MANAGER_H
+#define RULES_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <vector>
+#include "rule_table.h"
+
+// On-device automation: "when sensor pin 2 goes high, set pin 7 and move servo 4".
+// Sensor pins are digital inputs with a pull-up. A pin change interrupt wakes the
+// control task, which takes the new level at once and ignores further changes for
+// sensorDebounceMs, then runs the actions of the matching rules from a compiled
+// RuleTable. Uploads are validated and compiled on the web server task and handed
+// over through the command queue, so the control task never parses or allocates.
+// Actions go through the same apply functions as POST /pinValues, which skip pins
+// that lost their role since the rules were uploaded.
+namespace RulesManager {
+    const size_t MAX_ACTIONS_PER_RULE = 16;
+    const size_t MAX_REPORTED_ERRORS = 16; // Per upload, so the errors fit the 2 KB reply
+
+    // Control task only
+    void configureSensors(const std::vector<int>& pins);
+    bool poll(uint32_t nowMs); // True if LED colors changed
+    void install(RuleTable* table); // Takes ownership
+
+    // Any task
+    void describeSensors(JsonObject& target);
+
+    // REST handlers, web server task only. getRules returns as many whole rules from offset
+    // as fit the response document, "next" is where the following page starts.
+    void getRules(JsonDocument& response, size_t offset);
+    int postRules(JsonDocument& body, JsonDocument& response); // HTTP status
+}
+
+#endif
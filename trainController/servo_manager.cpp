@@ -0,0 +1,163 @@
+// servo_manager.cpp
+#include "servo_manager.h"
+#include "log_manager.h"
+#include <algorithm>
+#include <mutex>
+#include "esp32-hal-ledc.h"
+
+
+namespace ServoManager {
+
+    struct Servo {
+        int pin;
+        ServoCalibration calibration;
+        int target;         // Position 0-100
+        int32_t pulseQ4;    // Current pulse width in us, 4 fractional bits
+        int32_t targetQ4;
+        uint32_t duty;      // Last duty written
+    };
+
+    std::vector<Servo> servos;
+    std::mutex servoMutex; // describe() reads from the web server task
+    uint32_t lastUpdateMs = 0;
+
+    // Cost of the poll steps that moved a servo, under servoMutex
+    uint32_t pollSteps = 0;
+    uint64_t pollTotalUs = 0;
+    uint32_t pollMaxUs = 0;
+
+
+    int32_t positionToPulseQ4(const ServoCalibration& calibration, int position) {
+        return (calibration.minUs + (calibration.maxUs - calibration.minUs) * position / 100) << 4;
+    }
+
+
+    uint32_t pulseToDuty(int32_t pulseQ4) {
+        // duty = pulse / period * 2^bits, the period is 20000 us
+        return (uint32_t)pulseQ4 * (1 << SERVO_RESOLUTION_BITS) / ((1000000 / SERVO_FREQUENCY_HZ) << 4);
+    }
+
+
+    void write(Servo& servo) {
+        uint32_t duty = pulseToDuty(servo.pulseQ4);
+        if (duty != servo.duty) {
+            ledcWrite(servo.pin, duty);
+            servo.duty = duty;
+        }
+    }
+
+
+    std::vector<int> configure(const std::vector<int>& pins, const std::vector<ServoCalibration>& calibrations) {
+        std::lock_guard<std::mutex> lock(servoMutex);
+        std::vector<int> failed;
+
+        for (const Servo& servo : servos) {
+            if (std::find(pins.begin(), pins.end(), servo.pin) == pins.end()) {
+                ledcDetach(servo.pin);
+            }
+        }
+
+        std::vector<Servo> updated;
+        for (size_t i = 0; i < pins.size(); ++i) {
+            ServoCalibration calibration = i < calibrations.size() ? calibrations[i] : defaultServoCalibration;
+            auto it = std::find_if(servos.begin(), servos.end(), [&](const Servo& servo) { return servo.pin == pins[i]; });
+
+            if (it != servos.end()) {
+                // Keep moving from where it is, towards the same position on the new calibration
+                Servo servo = *it;
+                servo.calibration = calibration;
+                servo.targetQ4 = positionToPulseQ4(calibration, servo.target);
+                updated.push_back(servo);
+                continue;
+            }
+
+            // New servos start at position 0
+            if (!ledcAttach(pins[i], SERVO_FREQUENCY_HZ, SERVO_RESOLUTION_BITS)) {
+                LOG_ERROR(SERVO_ATTACH_FAILED, pins[i]);
+                failed.push_back(pins[i]);
+                continue;
+            }
+            Servo servo = {pins[i], calibration, 0, positionToPulseQ4(calibration, 0), 0, UINT32_MAX};
+            servo.targetQ4 = servo.pulseQ4;
+            write(servo);
+            updated.push_back(servo);
+        }
+        servos.swap(updated);
+
+        LOG_INFO(SERVOS_CONFIGURED, servos.size());
+        return failed;
+    }
+
+
+    bool setTarget(int pin, int position) {
+        std::lock_guard<std::mutex> lock(servoMutex);
+        for (Servo& servo : servos) {
+            if (servo.pin == pin) {
+                servo.target = position;
+                servo.targetQ4 = positionToPulseQ4(servo.calibration, position);
+                return true;
+            }
+        }
+        return false;
+    }
+
+
+    // Step every moving servo towards its target, once per pulse period
+    void poll(uint32_t nowMs) {
+        uint32_t elapsed = nowMs - lastUpdateMs;
+        if (elapsed < SERVO_UPDATE_MS) {
+            return;
+        }
+        lastUpdateMs = nowMs;
+        elapsed = std::min<uint32_t>(elapsed, 5 * SERVO_UPDATE_MS); // No jump after a stall
+
+        std::lock_guard<std::mutex> lock(servoMutex);
+        uint32_t start = micros();
+        bool moved = false;
+        for (Servo& servo : servos) {
+            int32_t remaining = servo.targetQ4 - servo.pulseQ4;
+            if (remaining == 0) {
+                continue;
+            }
+            moved = true;
+
+            int32_t travelQ4 = abs(servo.calibration.maxUs - servo.calibration.minUs) << 4;
+            int32_t step = (int64_t)travelQ4 * servo.calibration.speed * elapsed / (100 * 1000);
+            if (servo.calibration.speed == 0 || abs(remaining) <= step) {
+                servo.pulseQ4 = servo.targetQ4;
+            } else {
+                step = std::max<int32_t>(step, 1);
+                servo.pulseQ4 += remaining > 0 ? step : -step;
+            }
+            write(servo);
+        }
+
+        if (moved) {
+            uint32_t us = micros() - start;
+            pollSteps++;
+            pollTotalUs += us;
+            pollMaxUs = std::max(pollMaxUs, us);
+        }
+    }
+
+
+    void describe(JsonObject& target) {
+        std::lock_guard<std::mutex> lock(servoMutex);
+        for (const Servo& servo : servos) {
+            const ServoCalibration& calibration = servo.calibration;
+            int span = calibration.maxUs - calibration.minUs;
+            JsonObject obj = target.createNestedObject(String(servo.pin));
+            obj["position"] = span == 0 ? servo.target : ((servo.pulseQ4 >> 4) - calibration.minUs) * 100 / span;
+            obj["target"] = servo.target;
+            obj["pulseUs"] = servo.pulseQ4 >> 4;
+        }
+    }
+
+
+    void describeLoad(JsonObject target) {
+        std::lock_guard<std::mutex> lock(servoMutex);
+        target["steps"] = pollSteps;
+        target["avgUs"] = static_cast<uint32_t>(pollSteps > 0 ? pollTotalUs / pollSteps : 0);
+        target["maxUs"] = pollMaxUs;
+    }
+}
@@ -0,0 +1,42 @@
+// servo_manager.h
+#ifndef SERVO_MANAGER_H
+#define SERVO_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <vector>
+#include "input_config.h"
+
+// Hobby servos for turnouts and semaphore signals. Every servo gets an LEDC channel
+// at 50 Hz and 14 bits, about 1.2 us per step. The LEDC hardware generates the pulses
+// and only takes a new width at the end of a period. The control task moves each servo
+// towards its target at its own speed, one step per period, so a move needs one
+// request and no streaming.
+//
+// ESP32-C3 output budget: 6 LEDC channels on 4 timers, and 2 RMT TX channels that
+// the FastLED strips use. PWM pins (5 kHz) and servos (50 Hz) take one timer each
+// and share the 6 channels, so at most 6 servos minus the PWM pins.
+// Moving all 6 servos costs 6 interpolation steps and ledcWrite calls every 20 ms,
+// estimated (not measured) at under 0.5% of the CPU. poll() times itself, GET /status
+// reports the measured cost as "servoPoll".
+namespace ServoManager {
+    const uint32_t SERVO_FREQUENCY_HZ = 50;
+    const uint8_t SERVO_RESOLUTION_BITS = 14;
+    const uint32_t SERVO_UPDATE_MS = 1000 / SERVO_FREQUENCY_HZ; // One step per pulse
+    const int SERVO_MIN_PULSE_US = 500;
+    const int SERVO_MAX_PULSE_US = 2500;
+    const int SERVO_MAX_SPEED = 1000; // Percent of the travel per second
+    const size_t LEDC_CHANNELS = 6;   // Shared by pwmPins and servoPins
+
+    // Control task only. configure returns the pins whose LEDC channel could not be attached,
+    // they are left out and the caller must drop them from servoPins.
+    std::vector<int> configure(const std::vector<int>& pins, const std::vector<ServoCalibration>& calibrations);
+    bool setTarget(int pin, int position);
+    void poll(uint32_t nowMs);
+
+    // Any task
+    void describe(JsonObject& target);
+    void describeLoad(JsonObject target); // Poll steps since boot, their average and worst time
+}
+
+#endif
@@ -0,0 +1,92 @@
+// strip_buffers.h
+#ifndef STRIP_BUFFERS_H
+#define STRIP_BUFFERS_H
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// LED buffers of the FastLED strips, one per pin, rebuilt when the designation changes.
+// The new set is built next to the old one: strips that keep their length take their
+// buffer along, resized strips get a copy of their colors, new strips start black.
+// Buffers the new set does not use are returned in retired, for the caller to free
+// once no reader can see the old set. Templated on the pixel type (CRGB on the device)
+// so it builds without FastLED. No Arduino dependency.
+namespace StripBuffers {
+    template <typename Pixel>
+    struct Rebuild {
+        std::vector<Pixel*> leds;
+        std::vector<int> counts;
+        std::vector<std::string> types;
+        std::vector<Pixel*> retired;
+        size_t attached = 0;
+        size_t detached = 0;
+        size_t resized = 0;
+    };
+
+    template <typename Pixel>
+    Pixel* allocate(int count) {
+        Pixel* leds = new Pixel[count];
+        memset(static_cast<void*>(leds), 0, count * sizeof(Pixel));
+        return leds;
+    }
+
+    // requested holds one count per new pin, 0 keeps the current count (or the default for new strips)
+    template <typename Pixel>
+    Rebuild<Pixel> rebuild(const std::vector<int>& oldPins, const std::vector<Pixel*>& oldLeds,
+                           const std::vector<int>& oldCounts, const std::vector<std::string>& oldTypes,
+                           const std::vector<int>& pins, const std::vector<int>& requested,
+                           int defaultCount, const std::string& defaultType) {
+        Rebuild<Pixel> result;
+        std::vector<bool> kept(oldLeds.size(), false);
+
+        for (size_t i = 0; i < pins.size(); ++i) {
+            int wanted = i < requested.size() ? requested[i] : 0;
+            auto it = std::find(oldPins.begin(), oldPins.end(), pins[i]);
+
+            if (it != oldPins.end() && size_t(it - oldPins.begin()) < oldLeds.size()) {
+                size_t old = it - oldPins.begin();
+                int count = wanted > 0 ? wanted : oldCounts[old];
+                Pixel* leds = oldLeds[old];
+                if (count != oldCounts[old] || kept[old]) {
+                    // A repeated pin gets a copy, two strips never share a buffer
+                    leds = allocate<Pixel>(count);
+                    memcpy(static_cast<void*>(leds), oldLeds[old], std::min(count, oldCounts[old]) * sizeof(Pixel));
+                    result.resized += count != oldCounts[old];
+                } else {
+                    kept[old] = true;
+                }
+                result.leds.push_back(leds);
+                result.counts.push_back(count);
+                result.types.push_back(old < oldTypes.size() ? oldTypes[old] : defaultType);
+            } else {
+                int count = wanted > 0 ? wanted : defaultCount;
+                result.leds.push_back(allocate<Pixel>(count));
+                result.counts.push_back(count);
+                result.types.push_back(defaultType);
+                result.attached++;
+            }
+        }
+
+        for (size_t i = 0; i < oldLeds.size(); ++i) {
+            if (!kept[i]) {
+                result.retired.push_back(oldLeds[i]);
+            }
+            if (i < oldPins.size() && std::find(pins.begin(), pins.end(), oldPins[i]) == pins.end()) {
+                result.detached++;
+            }
+        }
+        return result;
+    }
+
+    template <typename Pixel>
+    void release(std::vector<Pixel*>& buffers) {
+        for (Pixel* leds : buffers) {
+            delete[] leds;
+        }
+        buffers.clear();
+    }
+}
+
+#endif
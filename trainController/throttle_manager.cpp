@@ -0,0 +1,158 @@
+// throttle_manager.cpp
+#include "throttle_manager.h"
+#include "control_task.h"
+#include "log_manager.h"
+#include <mutex>
+#include "esp32-hal-ledc.h"
+
+
+namespace ThrottleManager {
+
+    struct Throttle {
+        int inputPin;
+        int outputPin;       // -1 when unbound
+        int raw;             // Last averaged ADC reading
+        int32_t filteredQ4;  // EMA of raw, 4 fractional bits
+        int duty;            // Last duty written, -1 before the first write
+        bool remoteOverride;
+        int overrideRaw;     // Knob position when the override started
+    };
+
+    std::vector<Throttle> throttles;
+    std::mutex throttleMutex; // describe() reads from the web server task
+    bool adcRunning = false;
+
+
+    // Called from the ADC driver when a conversion frame is ready
+    void ARDUINO_ISR_ATTR onAdcFrame() {
+        ControlTask::notifyFromIsr();
+    }
+
+
+    void stopAdc() {
+        if (adcRunning) {
+            analogContinuousStop();
+            analogContinuousDeinit();
+            adcRunning = false;
+        }
+    }
+
+
+    void configure(const std::vector<int>& analogPins, const std::vector<int>& bindings) {
+        std::lock_guard<std::mutex> lock(throttleMutex);
+
+        // Nothing to restart if only the bindings changed
+        bool samePins = analogPins.size() == throttles.size();
+        for (size_t i = 0; samePins && i < analogPins.size(); ++i) {
+            samePins = throttles[i].inputPin == analogPins[i];
+        }
+
+        std::vector<Throttle> updated;
+        for (size_t i = 0; i < analogPins.size(); ++i) {
+            int output = i < bindings.size() ? bindings[i] : -1;
+            Throttle throttle = {analogPins[i], output, 0, 0, -1, false, 0};
+            if (samePins) {
+                // Keep the filter state so the outputs don't jump
+                throttle.raw = throttles[i].raw;
+                throttle.filteredQ4 = throttles[i].filteredQ4;
+                if (throttles[i].outputPin == output) {
+                    throttle.duty = throttles[i].duty;
+                    throttle.remoteOverride = throttles[i].remoteOverride;
+                    throttle.overrideRaw = throttles[i].overrideRaw;
+                }
+            }
+            updated.push_back(throttle);
+        }
+        throttles.swap(updated);
+
+        if (samePins) {
+            return;
+        }
+
+        stopAdc();
+        if (analogPins.empty()) {
+            return;
+        }
+
+        std::vector<uint8_t> pins(analogPins.begin(), analogPins.end());
+        analogContinuousSetWidth(12);
+        analogContinuousSetAtten(ADC_11db);
+        if (analogContinuous(pins.data(), pins.size(), ADC_CONVERSIONS_PER_PIN, ADC_SAMPLE_HZ, onAdcFrame) &&
+            analogContinuousStart()) {
+            adcRunning = true;
+            LOG_INFO(ADC_STARTED, pins.size());
+        } else {
+            LOG_ERROR(ADC_FAILED);
+        }
+    }
+
+
+    // Drain the latest ADC frame, filter and drive the bound outputs
+    void poll() {
+        if (!adcRunning) {
+            return;
+        }
+        adc_continuous_result_t* results = nullptr;
+        if (!analogContinuousRead(&results, 0)) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(throttleMutex);
+        for (Throttle& throttle : throttles) {
+            for (size_t i = 0; i < throttles.size(); ++i) {
+                if (results[i].pin != throttle.inputPin) {
+                    continue;
+                }
+                throttle.raw = results[i].avg_read_raw;
+                if (throttle.duty < 0 && throttle.filteredQ4 == 0) {
+                    throttle.filteredQ4 = throttle.raw << 4; // Start at the knob position
+                } else {
+                    throttle.filteredQ4 += ((throttle.raw << 4) - throttle.filteredQ4) >> FILTER_SHIFT;
+                }
+            }
+
+            if (throttle.outputPin < 0) {
+                continue;
+            }
+            int position = throttle.filteredQ4 >> 4;
+            if (throttle.remoteOverride) {
+                if (abs(position - throttle.overrideRaw) < TAKEOVER_RAW) {
+                    continue;
+                }
+                throttle.remoteOverride = false; // The operator took the knob back
+            }
+
+            int duty = position <= DEADBAND_RAW ? 0 : (position - DEADBAND_RAW) * 255 / (ADC_MAX_RAW - DEADBAND_RAW);
+            duty = constrain(duty, 0, 255);
+            // One step of hysteresis against ADC noise, but always reach the end stops
+            if (throttle.duty < 0 || abs(duty - throttle.duty) > 1 || ((duty == 0 || duty == 255) && duty != throttle.duty)) {
+                ledcWrite(throttle.outputPin, duty);
+                throttle.duty = duty;
+                PinManager::publishPwmDuty(throttle.outputPin, duty);
+            }
+        }
+    }
+
+
+    void noteRemoteWrite(int pwmPin) {
+        std::lock_guard<std::mutex> lock(throttleMutex);
+        for (Throttle& throttle : throttles) {
+            if (throttle.outputPin == pwmPin) {
+                throttle.remoteOverride = true;
+                throttle.overrideRaw = throttle.filteredQ4 >> 4;
+                throttle.duty = -1; // Write again once the knob takes over
+            }
+        }
+    }
+
+
+    void describe(JsonObject& target) {
+        std::lock_guard<std::mutex> lock(throttleMutex);
+        for (const Throttle& throttle : throttles) {
+            JsonObject obj = target.createNestedObject(String(throttle.inputPin));
+            obj["raw"] = throttle.raw;
+            obj["output"] = throttle.outputPin;
+            obj["source"] = throttle.remoteOverride ? "remote" : "local";
+        }
+    }
+}
@@ -0,0 +1,29 @@
+// throttle_manager.h
+#ifndef THROTTLE_MANAGER_H
+#define THROTTLE_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <vector>
+
+// Local throttle knobs: analog pins sampled by the ADC in continuous (DMA) mode,
+// filtered and written straight to their bound PWM pin on the control task.
+// A remote write to a bound PWM pin overrides the knob until the knob is moved.
+namespace ThrottleManager {
+    const uint32_t ADC_SAMPLE_HZ = 20000;        // Total conversion rate over all analog pins
+    const uint32_t ADC_CONVERSIONS_PER_PIN = 16; // Averaged by the driver per frame
+    const int FILTER_SHIFT = 2;                  // EMA weight 1/4 per frame
+    const int DEADBAND_RAW = 64;                 // Knob at the bottom end means stop
+    const int TAKEOVER_RAW = 200;                // Knob movement that ends a remote override
+    const int ADC_MAX_RAW = 4095;
+
+    // Control task only
+    void configure(const std::vector<int>& analogPins, const std::vector<int>& bindings);
+    void poll();
+    void noteRemoteWrite(int pwmPin);
+
+    // Any task
+    void describe(JsonObject& target);
+}
+
+#endif
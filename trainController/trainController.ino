@@ -6,6 +6,11 @@
 #include "status_led.h"
 #include "input_config.h"
 #include "log_manager.h"
+#include "control_task.h"
+#include "ota_manager.h"
+#include "api_router.h"
+#include "rules_manager.h"
+#include "servo_manager.h"
 
 
 // Server instance
@@ -17,122 +22,143 @@ WiFiState currentState = CONNECTING;
 unsigned long lastRetryTime = 0;
 unsigned long lastBlinkTime = 0;
 
+// REST endpoints, each served at its path and under /api/v2 in JSON or MessagePack.
+// Routes sharing a prefix are listed longest first.
+const ApiRouter::Route routes[] = {
+    //// pinDesignation
+    {"/pinDesignation", HTTP_GET, 0, 0, [](ApiRouter::Context& context) {
+        PinManager::getPinDesignation(context.response);
+    }, nullptr, PinManager::pinDesignationCapacity},
+    {"/pinDesignation", HTTP_POST, 1024, 1024, [](ApiRouter::Context& context) {
+        context.status = PinManager::postPinDesignation(context.body, context.response);
+    }, nullptr},
+    //// pinValues
+    {"/pinValues", HTTP_GET, 0, 0, [](ApiRouter::Context& context) {
+        PinManager::getPinValues(context.response);
+    }, nullptr, PinManager::pinValuesCapacity},
+    {"/pinValues", HTTP_POST, 1024, 1024, [](ApiRouter::Context& context) {
+        PinManager::postPinValues(context.body, context.response);
+    }, nullptr},
+    //// network
+    {"/network", HTTP_GET, 0, 1024, [](ApiRouter::Context& context) {
+        NetworkManager2::getNetworks(context.response);
+    }, nullptr},
+    {"/network", HTTP_POST, 1024, 256, [](ApiRouter::Context& context) {
+        NetworkManager2::postNetwork(context.body, context.response);
+    }, nullptr},
+    {"/network", HTTP_DELETE, 1024, 256, [](ApiRouter::Context& context) {
+        NetworkManager2::deleteNetwork(context.body, context.response);
+    }, nullptr},
+    // Temporarily connect to a specified WiFi network
+    {"/connect", HTTP_POST, 512, 256, [](ApiRouter::Context& context) {
+        NetworkManager2::postConnect(context.body, context.response);
+    }, nullptr},
+    //// Log, ?limit=<records>
+    {"/log", HTTP_GET, 0, 8192, [](ApiRouter::Context& context) {
+        AsyncWebServerRequest* request = context.request;
+        size_t limit = request->hasParam("limit") ? request->getParam("limit")->value().toInt() : 0;
+        getLog(context.response, limit);
+    }, nullptr},
+    //// Status: heap and uptime, polled by the soak test to spot leaks
+    {"/status", HTTP_GET, 0, 640, [](ApiRouter::Context& context) {
+        context.response["uptimeMs"] = millis();
+        context.response["freeHeap"] = ESP.getFreeHeap();
+        context.response["minFreeHeap"] = ESP.getMinFreeHeap();
+        context.response["maxAllocHeap"] = ESP.getMaxAllocHeap();
+        ApiRouter::describe(context.response.createNestedObject("formats"));
+        ServoManager::describeLoad(context.response.createNestedObject("servoPoll"));
+    }, nullptr},
+    //// Firmware update
+    {"/update/rollback", HTTP_POST, 0, 256, [](ApiRouter::Context& context) {
+        context.status = OtaManager::postRollback(context.request, context.response);
+    }, nullptr},
+    {"/update", HTTP_GET, 0, 512, [](ApiRouter::Context& context) {
+        OtaManager::getStatus(context.response);
+    }, nullptr},
+    // Multipart upload, streamed into the inactive partition
+    {"/update", HTTP_POST, 0, 256, [](ApiRouter::Context& context) {
+        context.status = OtaManager::handleUploadRequest(context.request, context.response);
+    }, OtaManager::handleUpload},
+    //// Latency
+    {"/latencyProfile", HTTP_GET, 0, 256, [](ApiRouter::Context& context) {
+        NetworkManager2::getLatencyProfile(context.response);
+    }, nullptr},
+    {"/latencyProfile", HTTP_POST, 256, 256, [](ApiRouter::Context& context) {
+        NetworkManager2::postLatencyProfile(context.body, context.response);
+    }, nullptr},
+    // Round trip probe, ?t=<client ms>&rtt=<previous rtt ms>&id=<client>
+    {"/ping", HTTP_GET, 0, 512, [](ApiRouter::Context& context) {
+        AsyncWebServerRequest* request = context.request;
+        String clientId = request->hasParam("id") ? request->getParam("id")->value() : request->client()->remoteIP().toString();
+        String clientTime = request->hasParam("t") ? request->getParam("t")->value() : "";
+        String lastRtt = request->hasParam("rtt") ? request->getParam("rtt")->value() : "";
+        context.status = NetworkManager2::getPing(clientId, clientTime, lastRtt, context.response);
+    }, nullptr},
+    //// Rules, ?offset=<rule> pages through large rule sets, the reply says where the "next" page starts
+    {"/rules", HTTP_GET, 0, 8192, [](ApiRouter::Context& context) {
+        AsyncWebServerRequest* request = context.request;
+        size_t offset = request->hasParam("offset") ? request->getParam("offset")->value().toInt() : 0;
+        RulesManager::getRules(context.response, offset);
+    }, nullptr},
+    // A 4 KB body holds about 50 rules, larger sets are sent in batches with "append"
+    {"/rules", HTTP_POST, 12288, 2048, [](ApiRouter::Context& context) {
+        context.status = RulesManager::postRules(context.body, context.response);
+    }, nullptr},
+    // Liveness check, served here under /api/v2 only, see setup()
+    {"/test", HTTP_GET, 0, 64, [](ApiRouter::Context& context) {
+        context.response["message"] = "Server is running";
+    }, nullptr},
+};
+
 void setup() {
     Serial.begin(115200);
+    initLog();
+    OtaManager::begin();
 
     // Initialize WiFi
-    Serial.println("Initializing WiFi...");
+    LOG_INFO(WIFI_INITIALIZING);
     if (!NetworkManager2::initializeWiFi()) {
-        Serial.println("Starting AP mode...");
+        LOG_INFO(AP_MODE_STARTING);
         currentState = AP_MODE;
     } else {
         currentState = CONNECTED;
-        Serial.println("Done Initializing WiFi...");
-        AddToLog("Done Initializing WiFi...");
+        LOG_INFO(WIFI_INITIALIZED);
     }
 
 
   
   // Initialize the pin manager for pin setups
-  Serial.println("Initializing pins");
-  AddToLog("Initializing pins");
   PinManager::initializePins();
-  Serial.println("Done Initializing pins...");
-  AddToLog("Done Initializing pins...");
+
+  // All pin writes from the REST handlers go through the control task
+  ControlTask::start();
 
 
   // Register REST endpoints
-  Serial.println("Setting up server...");
+  LOG_INFO(SERVER_SETUP);
+  // The original /test answers plain text, registered first so it wins over the table's /test
   server.on("/test", HTTP_GET, [](AsyncWebServerRequest* request) {
       request->send(200, "text/plain", "Server is running");
   });
-
-  //// pinDesignation
-  // Get
-  server.on("/pinDesignation", HTTP_GET, [](AsyncWebServerRequest *request) {
-      String response = PinManager::getPinDesignation();
-      request->send(200, "application/json", response);
-  });
-  // Post
-  server.on("/pinDesignation", HTTP_POST, [](AsyncWebServerRequest *request) {
-      if (request->hasParam("body", true)) {
-          String body = request->getParam("body", true)->value();
-          String response = PinManager::postPinDesignation(body);
-          request->send(200, "application/json", response);
-      } else {
-          request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
-      }
-  });
-  //// pinValues
-  // Get
-  server.on("/pinValues", HTTP_GET, [](AsyncWebServerRequest *request) {
-      String response = PinManager::getPinValues();
-      request->send(200, "application/json", response);
-  });
-  // Post
-  server.on("/pinValues", HTTP_POST, [](AsyncWebServerRequest *request) {
-      if (request->hasParam("body", true)) {
-          String body = request->getParam("body", true)->value();
-          String response = PinManager::postPinValues(body);
-          request->send(200, "application/json", response);
-      } else {
-          request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
-      }
-  });
-  //// network
-  // Get
-  server.on("/network", HTTP_GET, [](AsyncWebServerRequest* request) {
-      String response = NetworkManager2::getNetworks();
-      request->send(200, "application/json", response);
-  });
-  // Post
-  server.on("/network", HTTP_POST, [](AsyncWebServerRequest* request) {
-      if (request->hasParam("body", true)) {
-          String body = request->getParam("body", true)->value();
-          String response = NetworkManager2::postNetwork(body);
-          request->send(200, "application/json", response);
-      } else {
-          request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
-      }
-  });
-  // Delete
-  server.on("/network", HTTP_DELETE, [](AsyncWebServerRequest* request) {
-      if (request->hasParam("body", true)) {
-          String body = request->getParam("body", true)->value();
-          String response = NetworkManager2::deleteNetwork(body);
-          request->send(200, "application/json", response);
-      } else {
-          request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
-      }
-  });
-    //// Log
-    // Get
-    server.on("/log", HTTP_GET, [](AsyncWebServerRequest* request) {
-        String response = getLog();
-        request->send(200, "application/json", response);
-    });
-    // POST /connect: Temporarily connect to a specified WiFi network
-    server.on("/connect", HTTP_POST, [](AsyncWebServerRequest* request) {
-        if (request->hasParam("body", true)) {
-            String body = request->getParam("body", true)->value();
-            String response = NetworkManager2::postConnect(body);
-            request->send(200, "application/json", response);
-        } else {
-            request->send(400, "application/json", R"({"error":"Invalid JSON"})");
-        }
-    });
+  ApiRouter::registerRoutes(server, routes, sizeof(routes) / sizeof(routes[0]));
     //// Other, undefined routes
     // server.onNotFound([](AsyncWebServerRequest *request) {
     //   request->send(404, "application/json", "{\"error\":\"This is not the route you're looking for..\"}");
     // });
   
-  Serial.println("Starting server...");
+  LOG_INFO(SERVER_STARTING);
   server.begin();
-  Serial.println("Server started...");
+  LOG_INFO(SERVER_STARTED);
 }
 
 void loop() {
     unsigned long currentMillis = millis();
+
+    // Log records are formatted here, off the request and control paths
+    drainLogToSerial();
+
+    // Confirm a freshly updated image, restart after an update or rollback
+    OtaManager::loop(currentMillis);
     
     //status_led::handleBlinking();
     // Handle LED blinking
@@ -148,17 +174,17 @@ void loop() {
     switch (currentState) {
         case CONNECTING:
             if (WiFi.status() == WL_CONNECTED) {
-                Serial.println("Connected to WiFi: " + WiFi.localIP().toString());
+                LOG_INFO(WIFI_CONNECTED, WiFi.localIP());
                 currentState = CONNECTED;
                 isBlinking = false; // Stop blinking (solid LED)
-                Serial.println("isBlinking set to false");
+                LOG_DEBUG(BLINKING_OFF);
                 digitalWrite(statusLedPin, HIGH);
             } else if (currentMillis - lastRetryTime >= connectTimeout * 1000) {
                 isBlinking = true; // Blinking (solid LED)
                 interval = 500;              
-                Serial.println("isBlinking set to true");
+                LOG_DEBUG(BLINKING_ON);
                 lastRetryTime = currentMillis;
-                Serial.println("Retrying WiFi connection...");
+                LOG_INFO(WIFI_RETRY);
                 WiFi.reconnect();
             }
             break;
@@ -168,7 +194,7 @@ void loop() {
             // Periodically retry stored networks
             if (currentMillis - lastRetryTime >= AP_RETRY_INTERVAL * 1000) {
                 lastRetryTime = currentMillis;
-                Serial.println("Retrying stored networks...");
+                LOG_INFO(STORED_NETWORKS_RETRY);
                 if (NetworkManager2::tryStoredNetworks()) {
                     currentState = CONNECTED;
                     digitalWrite(statusLedPin, HIGH);